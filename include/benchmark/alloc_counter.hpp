@@ -0,0 +1,6 @@
+#pragma once
+#include <cstdint>
+
+// Process-wide count of global operator new calls, so a run can report how
+// many heap allocations the relay path made
+uint64_t heap_allocations();
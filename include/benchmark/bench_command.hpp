@@ -0,0 +1,9 @@
+#pragma once
+
+// `relay bench [flags]`: builds a network, runs one benchmark (or a ramp) and
+// writes the result as JSON or CSV, optionally checked against a baseline.
+// Returns the process exit code: 0 ok, 1 usage or I/O error, 2 regression.
+int run_bench(int argc, char *argv[]);
+
+// `relay compare <baseline.json> <run.json> [--threshold T]`
+int run_compare(int argc, char *argv[]);
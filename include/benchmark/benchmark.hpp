@@ -6,7 +6,29 @@
 #include <string>
 #include <mutex>
 #include <memory>
+#include <optional>
+#include <thread>
+#include <condition_variable>
+
+#include "benchmark/histogram.hpp"
+#include "benchmark/load_generator.hpp"
+#include "benchmark/topology.hpp"
+#include "core/peer_connection.hpp"
+#include "core/router.hpp"
+#include "core/socket_tuning.hpp"
+#include "core/span.hpp"
+
 class Node;
+class IoPool;
+
+// How connect_topology() links two nodes
+enum class BenchTransport
+{
+    Tcp,    // loopback sockets
+    Memory, // in-process MemoryTransport, the nodes need not listen
+    Local,  // AF_UNIX sockets
+    Shm     // ShmTransport rings
+};
 
 class Benchmark
 {
@@ -15,49 +37,158 @@ public:
     {
         uint64_t sent;
         uint64_t received;
-        uint64_t dropped;
+        uint64_t dropped;     // includes TTL expiries
+        uint64_t undelivered; // still queued or in flight once the run drained
         double msg_per_sec;
         uint64_t p50_ns;
+        uint64_t p90_ns;
         uint64_t p95_ns;
         uint64_t p99_ns;
+        uint64_t p999_ns;
+        uint64_t max_ns;
+        uint64_t allocations; // heap allocations during the run, whole process
+        double delivered_per_sec;
+
+        // Latency split by shortest-path distance between sender and receiver
+        struct HopLatency
+        {
+            int hops;
+            uint64_t received;
+            uint64_t p50_ns;
+            uint64_t p99_ns;
+        };
+        std::vector<HopLatency> by_hops;
+    };
+
+    // Latency over one reporting interval of a start()ed run
+    struct Interval
+    {
+        double end_s; // seconds since start
+        uint64_t received;
+        uint64_t p50_ns;
+        uint64_t p99_ns;
+        uint64_t p999_ns;
+    };
+
+    // Steps the offered rate up until latency or delivery falls apart
+    struct RampConfig
+    {
+        double start_rate = 1000;
+        double growth = 1.5;
+        double max_rate = 10'000'000;
+        std::chrono::seconds step{5};
+
+        // A step is sustainable while both limits hold
+        uint64_t max_p99_ns = 1'000'000;
+        double min_delivery = 0.99;
     };
 
-    // Static node generator
+    struct RampStep
+    {
+        double target_rate;
+        Result result;
+        bool sustainable;
+    };
+
+    // Static node generator; with a pool, nodes share its io threads
+    // instead of spawning one thread each. The pool must outlive the nodes.
+    // Without `listen` no ports are bound, for memory-only networks.
     static std::vector<std::unique_ptr<Node>>
     generate_nodes(std::size_t count,
-                   uint16_t base_port);
+                   uint16_t base_port,
+                   IoPool *pool = nullptr,
+                   bool listen = true,
+                   const SocketTuning &tuning = {});
 
     // Connectors
 
     void connect_server_client(int server_index = 0);
 
-    // void connect_cycle_topology();
+    // Link every edge of the topology with the selected transport, or the
+    // one the topology names for it. Targets of local and shm links start
+    // listening on a socket in the temp directory.
+    void connect_topology(const Topology &topology);
+    void set_transport(BenchTransport transport) { transport_ = transport; }
+
+    // Wiring used by start()/ramp(); defaults to a star around node 0
+    void set_topology(Topology topology) { topology_ = std::move(topology); }
 
+    // Installs delivery handlers that point into this object: destroy the
+    // nodes before the Benchmark
     Benchmark(std::vector<std::unique_ptr<Node>> &nodes,
-              uint64_t duration_seconds);
+              uint64_t duration_seconds,
+              const LoadConfig &load = {});
+    ~Benchmark();
+
+    // Print and keep a latency snapshot every `interval` while running; 0 disables
+    void set_report_interval(std::chrono::seconds interval) { report_interval_ = interval; }
+    const std::vector<Interval> &intervals() const { return intervals_; }
+
+    // Applied to every node, before start()
+    void set_routing_mode(RoutingMode mode);
+    void set_connection_options(const ConnectionOptions &options);
 
     void start();
     Result wait_and_collect();
 
+    // Alternative to start()/wait_and_collect(): the last sustainable step
+    // is the maximum throughput the network can take
+    std::vector<RampStep> ramp(const RampConfig &config);
+
 private:
     void on_receive(uint64_t node_id,
                     uint64_t from_id,
-                    const std::string &msg);
+                    Span<const uint8_t> msg);
 
     void run_nodes();
-    void send_tick();
+    std::string local_path_(std::size_t index);
+    void prepare_();
+    void begin_window_();
+    void end_window_();
+    uint64_t window_drops_() const;
+    Result collect_();
+    void report_loop_();
+    void send_one_(std::size_t producer, uint64_t seq, uint64_t intended_ns,
+                   std::size_t payload_size);
 
 private:
     std::vector<std::unique_ptr<Node>> &nodes_;
     const uint64_t duration_s_;
+    LoadConfig load_config_;
+    std::unique_ptr<LoadGenerator> load_;
+
+    // Per-producer sender cursor and payload scratch, on its own cache line
+    struct alignas(64) Producer
+    {
+        std::size_t next_sender = 0;
+        std::string payload;
+    };
+    std::vector<Producer> producers_;
+    std::size_t dst_index_{0};
 
     std::atomic<uint64_t> sent_{0};
     std::atomic<uint64_t> received_{0};
     std::atomic<uint64_t> dropped_{0};
 
-    std::mutex latency_mtx_;
-    std::vector<uint64_t> latencies_ns_;
+    // Written by the io threads, each into its own histogram
+    PerThreadHistograms latencies_;
+    HistogramSnapshot window_start_;
+
+    std::optional<Topology> topology_;
+    BenchTransport transport_{BenchTransport::Tcp};
+    std::vector<int> hops_; // per node index, toward the destination
+    std::vector<std::unique_ptr<PerThreadHistograms>> hop_latencies_;
+    std::vector<HistogramSnapshot> hop_window_start_;
+
+    std::chrono::seconds report_interval_{0};
+    std::thread reporter_;
+    std::mutex reporter_mtx_;
+    std::condition_variable reporter_cv_;
+    std::vector<Interval> intervals_;
 
     std::atomic<bool> running_{false};
     std::chrono::steady_clock::time_point start_tp_;
+    std::chrono::steady_clock::time_point end_tp_; // load stopped
+    uint64_t start_allocations_{0};
+    uint64_t start_node_drops_{0};
 };
@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Log-linear (HDR-style) latency histogram: values below 128 are exact and
+// every power of two above is split into 64 linear sub-buckets, so any
+// recorded value is reported within ~1.6%. Memory is fixed regardless of
+// how many values are recorded.
+class LatencyHistogram
+{
+public:
+    static constexpr std::size_t sub_buckets = 64;
+    static constexpr std::size_t bucket_count = 2 * sub_buckets + 57 * sub_buckets;
+
+    // One writer thread; counters are atomics so snapshots can run concurrently
+    void record(uint64_t value)
+    {
+        counts_[index_of(value)].fetch_add(1, std::memory_order_relaxed);
+        if (value > max_.load(std::memory_order_relaxed))
+            max_.store(value, std::memory_order_relaxed);
+    }
+
+    static std::size_t index_of(uint64_t value);
+    static uint64_t value_at(std::size_t index);
+
+private:
+    friend class HistogramSnapshot;
+
+    std::array<std::atomic<uint64_t>, bucket_count> counts_{};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Plain copy of one or more histograms, merged
+class HistogramSnapshot
+{
+public:
+    HistogramSnapshot() : counts_(LatencyHistogram::bucket_count, 0) {}
+
+    void add(const LatencyHistogram &h);
+
+    // Counts recorded after `earlier` was taken; max is bucket-accurate
+    HistogramSnapshot since(const HistogramSnapshot &earlier) const;
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+    uint64_t percentile(double p) const;
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_{0};
+    uint64_t max_{0};
+};
+
+// One histogram per recording thread, so the hot path never contends
+class PerThreadHistograms
+{
+public:
+    PerThreadHistograms();
+
+    // Histogram owned by the calling thread
+    LatencyHistogram &local();
+
+    HistogramSnapshot snapshot() const;
+
+private:
+    mutable std::mutex mtx_; // only taken when a thread registers or on snapshot
+    std::vector<std::unique_ptr<LatencyHistogram>> histograms_;
+    const uint64_t id_;
+};
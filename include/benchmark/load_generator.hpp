@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+struct LoadConfig
+{
+    std::size_t producers = 1;
+
+    // Target rate over all producers in msg/s; 0 sends as fast as possible
+    double rate = 5000;
+
+    // Payload sizes are drawn uniformly from [min_payload, max_payload]
+    std::size_t min_payload = 16;
+    std::size_t max_payload = 16;
+};
+
+// Open-loop load: every producer thread follows a fixed schedule of intended
+// send times, independent of how fast the system under test responds. When
+// a producer falls behind it catches up immediately, and the intended time
+// (not the actual one) is reported, so stalls show up as latency instead of
+// silently lowering the offered load (coordinated omission correction).
+class LoadGenerator
+{
+public:
+    // Called on producer threads with the intended send time of the message
+    using SendFn = std::function<void(std::size_t producer,
+                                      uint64_t seq,
+                                      uint64_t intended_ns,
+                                      std::size_t payload_size)>;
+
+    LoadGenerator(const LoadConfig &config, SendFn send);
+    ~LoadGenerator();
+
+    LoadGenerator(const LoadGenerator &) = delete;
+    LoadGenerator &operator=(const LoadGenerator &) = delete;
+
+    void start();
+    void stop();
+
+    // Messages the schedule asked for so far, sent or not
+    uint64_t scheduled() const { return scheduled_.load(std::memory_order_relaxed); }
+
+private:
+    void produce_(std::size_t producer);
+
+    LoadConfig config_;
+    SendFn send_;
+
+    std::vector<std::thread> threads_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> scheduled_{0};
+};
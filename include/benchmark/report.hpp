@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+
+// Parameters of a `relay bench` run, recorded next to its results so two
+// runs can be checked for comparability
+struct BenchConfig
+{
+    std::size_t nodes = 10;
+    std::string topology = "star";
+    std::string routing = "flood";
+    std::string transport = "tcp";
+    std::string tuning = "default"; // SocketTuning::describe() of every node
+    std::size_t pool_threads = 0; // 0: one io thread per node
+    uint16_t base_port = 10000;
+    uint64_t seed = 1;
+
+    double rate = 5000;
+    std::size_t producers = 1;
+    uint64_t duration_s = 10;
+    std::size_t min_payload = 16;
+    std::size_t max_payload = 16;
+    uint64_t coalesce_us = 0;
+    bool ramp = false;
+};
+
+// Where a run happened; captured once per run
+struct BenchEnvironment
+{
+    std::string timestamp; // UTC, ISO 8601
+    std::string hostname;
+    std::string cpu_model;
+    unsigned cores = 0;
+    std::string kernel;
+    std::string compiler;
+    std::string boost;
+    std::string git_rev;
+    std::string io_backend; // of TCP links: "epoll" or "io_uring"
+
+    static BenchEnvironment capture();
+};
+
+struct BenchReport
+{
+    BenchConfig config;
+    BenchEnvironment environment;
+    Benchmark::Result result{};
+    std::vector<Benchmark::Interval> intervals;
+    std::vector<Benchmark::RampStep> ramp;
+};
+
+// One JSON document per run
+void write_json(std::ostream &out, const BenchReport &report);
+
+// One row per run; the header is written separately so runs can be appended
+void write_csv_header(std::ostream &out);
+void write_csv_row(std::ostream &out, const BenchReport &report);
+
+// Reads back what write_json produced (config, environment and result);
+// throws std::runtime_error on unreadable files
+BenchReport read_json(const std::string &path);
+
+struct MetricDelta
+{
+    std::string metric;
+    double baseline;
+    double current;
+    double change; // relative, positive means the metric grew
+    bool regression;
+};
+
+// Throughput regresses when it falls by more than `threshold` (relative),
+// latency percentiles when they grow by more than it
+std::vector<MetricDelta> compare(const BenchReport &baseline,
+                                 const BenchReport &current,
+                                 double threshold);
+
+// Config fields that differ between the two runs, empty when comparable
+std::vector<std::string> config_differences(const BenchConfig &a, const BenchConfig &b);
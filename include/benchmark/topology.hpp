@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Transport a map asks for on one edge
+enum class EdgeLink : uint8_t
+{
+    Default, // whatever the benchmark runs with
+    Local,   // local:// (AF_UNIX stream)
+    Shm      // shm:// (shared-memory rings)
+};
+
+// Undirected graph over node indices [0, size). Every edge becomes one
+// connection, dialed from `first` to `second`.
+struct Topology
+{
+    std::string name;
+    std::size_t size = 0;
+    std::vector<std::pair<std::size_t, std::size_t>> edges;
+    // Per edge, only filled in by from_map; empty means all Default
+    std::vector<EdgeLink> links;
+
+    EdgeLink link(std::size_t edge) const { return edge < links.size() ? links[edge] : EdgeLink::Default; }
+
+    static Topology star(std::size_t n, std::size_t center = 0);
+    static Topology line(std::size_t n);
+    static Topology ring(std::size_t n);
+    // 2D mesh, ceil(sqrt(n)) columns
+    static Topology grid(std::size_t n);
+    // Every node has degree k (n * k must be even)
+    static Topology random_regular(std::size_t n, std::size_t k, uint64_t seed = 1);
+    // Ring lattice of degree k, each edge rewired with probability beta
+    static Topology watts_strogatz(std::size_t n, std::size_t k, double beta, uint64_t seed = 1);
+    // Preferential attachment, m edges per new node
+    static Topology barabasi_albert(std::size_t n, std::size_t m, uint64_t seed = 1);
+
+    // CLI script format of assets/map.txt: 'add <id> <port> [local://<path>]'
+    // declares the nodes in order, 'connect <id> <host> <port>' or
+    // 'connect <id> <local|shm>://<path>' links them; other lines are
+    // ignored. Duplicate links are kept.
+    static Topology from_map(const std::string &path);
+
+    // Named spec: star, line, ring, grid, regular:<k>, ws:<k>:<beta>,
+    // ba:<m> or map:<path> (which ignores n)
+    static Topology parse(const std::string &spec, std::size_t n, uint64_t seed = 1);
+
+    // BFS hop count from src to every node, -1 when unreachable
+    std::vector<int> hops_from(std::size_t src) const;
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Size-class free lists for frame storage. Freed blocks are kept for reuse,
+// so a node relaying at a steady rate stops hitting the heap.
+// Not thread-safe: a pool belongs to one node and is used on its io thread.
+class BufferPool
+{
+public:
+    static constexpr std::array<std::size_t, 7> size_classes{64, 256, 1024, 4096, 16384, 65536, 262144};
+
+    struct Stats
+    {
+        uint64_t hits;     // served from a free list
+        uint64_t misses;   // fresh block from the heap
+        uint64_t oversize; // larger than the biggest class, not pooled
+    };
+
+    explicit BufferPool(std::size_t max_cached_per_class = 4096);
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    void *allocate(std::size_t size);
+    void deallocate(void *p, std::size_t size);
+
+    const Stats &stats() const { return stats_; }
+    // Blocks handed out and not yet given back
+    std::size_t outstanding() const { return outstanding_; }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    static std::size_t class_of_(std::size_t size);
+
+    std::array<FreeBlock *, size_classes.size()> free_{};
+    std::array<std::size_t, size_classes.size()> cached_{};
+    std::size_t max_cached_;
+    std::size_t outstanding_ = 0;
+    Stats stats_{};
+};
+
+// Owning byte buffer carved from a BufferPool, or from the heap without one
+class PooledBuffer
+{
+public:
+    PooledBuffer() = default;
+    PooledBuffer(BufferPool *pool, std::size_t size);
+    ~PooledBuffer() { release_(); }
+
+    PooledBuffer(PooledBuffer &&other) noexcept;
+    PooledBuffer &operator=(PooledBuffer &&other) noexcept;
+    PooledBuffer(const PooledBuffer &) = delete;
+    PooledBuffer &operator=(const PooledBuffer &) = delete;
+
+    uint8_t *data() { return data_; }
+    const uint8_t *data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    void release_();
+
+    BufferPool *pool_{nullptr};
+    uint8_t *data_{nullptr};
+    std::size_t size_{0};
+};
+
+// Standard allocator over a BufferPool, for std::allocate_shared and friends
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(BufferPool &pool) : pool_(&pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool_(other.pool()) {}
+
+    T *allocate(std::size_t n) { return static_cast<T *>(pool_->allocate(n * sizeof(T))); }
+    void deallocate(T *p, std::size_t n) { pool_->deallocate(p, n * sizeof(T)); }
+
+    BufferPool *pool() const { return pool_; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &other) const { return pool_ == other.pool(); }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &other) const { return pool_ != other.pool(); }
+
+private:
+    BufferPool *pool_;
+};
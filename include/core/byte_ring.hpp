@@ -0,0 +1,84 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Cursors of a ByteRing. Kept apart from the data so both can be placed in
+// memory shared between processes; the atomics must then be lock-free.
+struct RingIndex
+{
+    alignas(64) std::atomic<uint64_t> head{0}; // consumer
+    alignas(64) std::atomic<uint64_t> tail{0}; // producer
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring cursors must be lock-free");
+
+// Single-producer single-consumer byte ring over external storage;
+// capacity must be a power of two. Copies never leave the storage, even if
+// a process sharing it corrupts the cursors.
+class ByteRing
+{
+public:
+    ByteRing(RingIndex &index, uint8_t *data, std::size_t capacity)
+        : index_(&index), data_(data), capacity_(capacity), mask_(capacity - 1) {}
+
+    std::size_t write(const uint8_t *src, std::size_t n)
+    {
+        uint64_t tail = index_->tail.load(std::memory_order_relaxed);
+        uint64_t head = index_->head.load(std::memory_order_acquire);
+        n = std::min<std::size_t>({n, capacity_ - (tail - head), capacity_});
+        if (n == 0)
+            return 0;
+
+        std::size_t offset = tail & mask_;
+        std::size_t first = std::min(n, capacity_ - offset);
+        std::memcpy(data_ + offset, src, first);
+        std::memcpy(data_, src + first, n - first);
+
+        index_->tail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    std::size_t read(uint8_t *dst, std::size_t n)
+    {
+        uint64_t head = index_->head.load(std::memory_order_relaxed);
+        uint64_t tail = index_->tail.load(std::memory_order_acquire);
+        n = std::min<std::size_t>({n, tail - head, capacity_});
+        if (n == 0)
+            return 0;
+
+        std::size_t offset = head & mask_;
+        std::size_t first = std::min(n, capacity_ - offset);
+        std::memcpy(dst, data_ + offset, first);
+        std::memcpy(dst + first, data_, n - first);
+
+        index_->head.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    bool empty() const
+    {
+        return index_->head.load(std::memory_order_acquire) == index_->tail.load(std::memory_order_acquire);
+    }
+    bool full() const
+    {
+        return index_->tail.load(std::memory_order_acquire) - index_->head.load(std::memory_order_acquire) ==
+               capacity_;
+    }
+
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    RingIndex *index_;
+    uint8_t *data_;
+    std::size_t capacity_;
+    std::size_t mask_;
+};
+
+inline std::size_t round_up_pow2(std::size_t n)
+{
+    std::size_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <boost/system/error_code.hpp>
+
+// Move-only void(error_code, std::size_t) callable stored inline, so that
+// handing a completion to a transport never allocates. std::function can
+// not promise that: libstdc++ only keeps trivially copyable functors inline,
+// and a lambda capturing a shared_ptr is not one. Functors that do not fit
+// are rejected at compile time.
+class CompletionHandler
+{
+public:
+    // A shared_ptr and a couple of words
+    static constexpr std::size_t kCapacity = 4 * sizeof(void *);
+
+    CompletionHandler() = default;
+    CompletionHandler(std::nullptr_t) {}
+
+    template <typename F, typename Fn = std::decay_t<F>,
+              typename = std::enable_if_t<!std::is_same_v<Fn, CompletionHandler> &&
+                                          !std::is_same_v<Fn, std::nullptr_t>>>
+    CompletionHandler(F &&f)
+    {
+        static_assert(sizeof(Fn) <= kCapacity && alignof(Fn) <= alignof(std::max_align_t),
+                      "completion handler too large to store inline");
+        static_assert(std::is_nothrow_move_constructible_v<Fn>, "completion handler must move without throwing");
+        ::new (static_cast<void *>(storage_)) Fn(std::forward<F>(f));
+        ops_ = &kOps<Fn>;
+    }
+
+    CompletionHandler(CompletionHandler &&other) noexcept { take_(other); }
+    CompletionHandler &operator=(CompletionHandler &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset_();
+            take_(other);
+        }
+        return *this;
+    }
+    CompletionHandler &operator=(std::nullptr_t)
+    {
+        reset_();
+        return *this;
+    }
+    ~CompletionHandler() { reset_(); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void operator()(boost::system::error_code ec, std::size_t n) { ops_->call(storage_, ec, n); }
+
+private:
+    struct Ops
+    {
+        void (*call)(void *, boost::system::error_code, std::size_t);
+        void (*move)(void *from, void *to); // leaves `from` destroyed
+        void (*destroy)(void *);
+    };
+
+    template <typename Fn>
+    static constexpr Ops kOps = {
+        [](void *f, boost::system::error_code ec, std::size_t n)
+        { (*static_cast<Fn *>(f))(ec, n); },
+        [](void *from, void *to)
+        {
+            ::new (to) Fn(std::move(*static_cast<Fn *>(from)));
+            static_cast<Fn *>(from)->~Fn();
+        },
+        [](void *f)
+        { static_cast<Fn *>(f)->~Fn(); }};
+
+    void take_(CompletionHandler &other) noexcept
+    {
+        if (other.ops_)
+        {
+            other.ops_->move(other.storage_, storage_);
+            ops_ = std::exchange(other.ops_, nullptr);
+        }
+    }
+
+    void reset_() noexcept
+    {
+        if (ops_)
+            std::exchange(ops_, nullptr)->destroy(storage_);
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[kCapacity];
+    const Ops *ops_ = nullptr;
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <boost/asio/buffer.hpp>
+
+#include "buffer_pool.hpp"
+#include "message.hpp"
+#include "span.hpp"
+#include "wire.hpp"
+
+class Frame;
+using FramePtr = std::shared_ptr<const Frame>;
+
+// Immutable wire frame, built once and shared by every peer it is sent to.
+// The header is encoded in every wire version up front, so each connection
+// picks the one it negotiated; header and payload go out as a gather write.
+class Frame
+{
+public:
+    // With a pool both the frame and its payload come from its free lists
+    static FramePtr make(BufferPool *pool, const MessageHeader &header, Span<const uint8_t> payload);
+    static FramePtr make(BufferPool *pool, const Message &msg);
+
+    Frame(const MessageHeader &header, PooledBuffer payload);
+
+    const MessageHeader &header() const { return header_; }
+    Span<const uint8_t> payload() const { return {payload_.data(), payload_.size()}; }
+    // Queue accounting size: the fixed header counts whatever version the
+    // frame goes out in, so the figure does not change once queued
+    std::size_t size() const { return kFixedHeaderSize + payload_.size(); }
+
+    std::array<boost::asio::const_buffer, 2> buffers(uint8_t version) const
+    {
+        return {version == kWireCompact ? boost::asio::buffer(compact_.data(), compact_size_)
+                                        : boost::asio::buffer(fixed_.data(), fixed_.size()),
+                boost::asio::buffer(payload_.data(), payload_.size())};
+    }
+
+private:
+    MessageHeader header_;
+    std::array<uint8_t, kFixedHeaderSize> fixed_;
+    std::array<uint8_t, kMaxCompactHeaderSize> compact_;
+    uint8_t compact_size_;
+    PooledBuffer payload_;
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <boost/asio.hpp>
+
+// Storage for the one asio operation an object has in flight for a given
+// purpose, e.g. a socket read, a write or a posted wakeup. asio frees an
+// operation's memory before it invokes the handler, so the next operation
+// started from that handler finds the block free again. A busy block or an
+// operation larger than the block falls back to the heap. The flag is
+// atomic because a post may be allocated on one thread and freed on another.
+class HandlerMemory
+{
+public:
+    // Enough for a posted completion or a socket read
+    static constexpr std::size_t kDefaultCapacity = 256;
+
+    explicit HandlerMemory(std::size_t capacity = kDefaultCapacity)
+        : block_(::operator new(capacity)), capacity_(capacity) {}
+    ~HandlerMemory() { ::operator delete(block_); }
+
+    HandlerMemory(const HandlerMemory &) = delete;
+    HandlerMemory &operator=(const HandlerMemory &) = delete;
+
+    void *allocate(std::size_t size)
+    {
+        if (size <= capacity_ && !in_use_.exchange(true, std::memory_order_acquire))
+            return block_;
+        return ::operator new(size);
+    }
+
+    void deallocate(void *p)
+    {
+        if (p == block_)
+            in_use_.store(false, std::memory_order_release);
+        else
+            ::operator delete(p);
+    }
+
+private:
+    void *block_;
+    std::size_t capacity_;
+    std::atomic<bool> in_use_{false};
+};
+
+template <typename T>
+class HandlerAllocator
+{
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory &memory) noexcept : memory_(&memory) {}
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U> &other) noexcept : memory_(other.memory_) {}
+
+    T *allocate(std::size_t n) { return static_cast<T *>(memory_->allocate(sizeof(T) * n)); }
+    void deallocate(T *p, std::size_t) { memory_->deallocate(p); }
+
+    bool operator==(const HandlerAllocator &other) const noexcept { return memory_ == other.memory_; }
+    bool operator!=(const HandlerAllocator &other) const noexcept { return memory_ != other.memory_; }
+
+private:
+    template <typename>
+    friend class HandlerAllocator;
+
+    HandlerMemory *memory_;
+};
+
+// Handler whose operations asio allocates from a HandlerMemory
+template <typename Handler>
+class MemoryBoundHandler
+{
+public:
+    using allocator_type = HandlerAllocator<void>;
+
+    MemoryBoundHandler(HandlerMemory &memory, Handler handler) : memory_(&memory), handler_(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(*memory_); }
+
+    template <typename... Args>
+    void operator()(Args &&...args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+
+private:
+    HandlerMemory *memory_;
+    Handler handler_;
+};
+
+template <typename Handler>
+MemoryBoundHandler<std::decay_t<Handler>> bind_memory(HandlerMemory &memory, Handler &&handler)
+{
+    return {memory, std::forward<Handler>(handler)};
+}
+
+// Posts fn to ex, its operation allocated from `memory`. any_io_executor has
+// no allocator property and wraps the function once more on the heap, so an
+// io_context behind it is posted to directly.
+template <typename Fn>
+void post_with_memory(const boost::asio::any_io_executor &ex, HandlerMemory &memory, Fn &&fn)
+{
+    if (auto *io = ex.target<boost::asio::io_context::executor_type>())
+        boost::asio::post(*io, bind_memory(memory, std::forward<Fn>(fn)));
+    else
+        boost::asio::post(ex, std::forward<Fn>(fn));
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "socket_tuning.hpp"
+
+// Fixed set of io_context threads that many Nodes can share.
+// Every context is driven by exactly one thread, so a Node bound to a context
+// keeps the same single-threaded handler guarantees as with its own thread.
+class IoPool
+{
+public:
+    // Thread i is placed on the i-th CPU of `placement`, when it names any
+    explicit IoPool(std::size_t threads = std::thread::hardware_concurrency(),
+                    const SocketTuning &placement = {});
+    ~IoPool();
+
+    IoPool(const IoPool &) = delete;
+    IoPool &operator=(const IoPool &) = delete;
+
+    // Round-robin pick of the context the next Node should live on
+    boost::asio::io_context &next();
+
+    void stop();
+
+    std::size_t size() const { return contexts_.size(); }
+
+private:
+    using WorkGuard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+    std::vector<std::unique_ptr<boost::asio::io_context>> contexts_;
+    std::vector<WorkGuard> work_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> next_{0};
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "transport.hpp"
+
+using local_socket = boost::asio::local::stream_protocol::socket;
+
+// Same-host links, set up over an AF_UNIX stream socket. The dialing side
+// opens with a one-byte preamble naming the link; a shared-memory link
+// passes its segment and eventfds along with it (SCM_RIGHTS).
+enum class LocalLink : char
+{
+    Stream = 'S', // bytes flow through the socket itself
+    Shm = 'M'     // bytes flow through ShmTransport rings
+};
+
+// local://<path> or shm://<path>
+struct LocalEndpoint
+{
+    std::string path;
+    LocalLink link = LocalLink::Stream;
+
+    static std::optional<LocalEndpoint> parse(const std::string &uri);
+    std::string uri() const;
+};
+
+class LocalTransport : public Transport
+{
+public:
+    LocalTransport(local_socket socket, std::string remote);
+
+    void async_read_some(boost::asio::mutable_buffer buffer, Handler handler) override;
+    void async_write(ConstBuffers buffers, Handler handler) override;
+    void close() override;
+    bool is_open() const override { return socket_.is_open(); }
+
+    boost::asio::any_io_executor get_executor() override { return socket_.get_executor(); }
+    std::string remote() const override { return remote_; }
+
+private:
+    HandlerMemory read_memory_;
+    HandlerMemory write_memory_{kWriteMemory};
+    local_socket socket_;
+    std::string remote_;
+};
+
+// Blocking send of the preamble on a freshly connected socket. The fds are
+// only lent: the caller still owns and closes them.
+void send_preamble(local_socket &socket, LocalLink link, const std::vector<int> &fds = {});
+
+// Dialing side, once connected: sends the preamble and wraps the socket
+std::unique_ptr<Transport> open_local_link(local_socket socket, const LocalEndpoint &ep);
+
+// Accepting side, once the socket is readable: reads the preamble and builds
+// the transport it asks for. Returns nullptr if the preamble has not arrived
+// yet; throws if the peer hung up or sent something else.
+std::unique_ptr<Transport> accept_local_link(local_socket &socket, const std::string &path);
@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+enum class LogLevel : uint8_t
+{
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off
+};
+
+// Statements below this level are compiled out; set through the
+// RELAY_LOG_LEVEL CMake option
+#ifndef RELAY_LOG_MIN_LEVEL
+#define RELAY_LOG_MIN_LEVEL 1
+#endif
+constexpr LogLevel kLogMinLevel = static_cast<LogLevel>(RELAY_LOG_MIN_LEVEL);
+
+// Process-wide asynchronous logger. Callers format into a thread-local buffer
+// and publish the line into a bounded lock-free ring; a background thread
+// writes the ring to stderr. A full ring drops the line instead of blocking,
+// so logging never stalls an io thread.
+class Logger
+{
+public:
+    static Logger &instance();
+
+    static bool enabled(LogLevel level) { return level >= instance().level_.load(std::memory_order_relaxed); }
+    void set_level(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+
+    // Lines lost to a full ring
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // Blocks until everything logged so far has been written
+    void flush();
+
+    // "trace", "debug", "info", "warn", "error" or "off"; false if unknown
+    static bool parse_level(const std::string &name, LogLevel &level);
+
+    void push(LogLevel level, const char *text, std::size_t size);
+
+    ~Logger();
+
+private:
+    Logger();
+    void run_();
+    bool write_pending_();
+
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    std::atomic<LogLevel> level_{LogLevel::Info};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+// Fixed-size line buffer; output past the end is cut off
+class LogBuffer : public std::streambuf
+{
+public:
+    static constexpr std::size_t capacity = 224;
+
+    LogBuffer() { reset(); }
+    void reset() { setp(data_, data_ + capacity); }
+    const char *data() const { return data_; }
+    std::size_t size() const { return static_cast<std::size_t>(pptr() - pbase()); }
+
+private:
+    char data_[capacity];
+};
+
+// One log statement: streams into a per-thread LogBuffer and hands the line
+// to the Logger when destroyed. Log expressions must not log themselves.
+class LogLine
+{
+public:
+    explicit LogLine(LogLevel level);
+    ~LogLine();
+
+    LogLine(const LogLine &) = delete;
+    LogLine &operator=(const LogLine &) = delete;
+
+    std::ostream &stream() { return out_; }
+
+private:
+    LogLevel level_;
+    LogBuffer &buffer_;
+    std::ostream &out_;
+};
+
+#define RELAY_LOG(level, expr)                     \
+    do                                             \
+    {                                              \
+        if constexpr ((level) >= kLogMinLevel)     \
+        {                                          \
+            if (Logger::enabled(level))            \
+                LogLine(level).stream() << expr;   \
+        }                                          \
+    } while (0)
+
+#define LOG_TRACE(expr) RELAY_LOG(LogLevel::Trace, expr)
+#define LOG_DEBUG(expr) RELAY_LOG(LogLevel::Debug, expr)
+#define LOG_INFO(expr) RELAY_LOG(LogLevel::Info, expr)
+#define LOG_WARN(expr) RELAY_LOG(LogLevel::Warn, expr)
+#define LOG_ERROR(expr) RELAY_LOG(LogLevel::Error, expr)
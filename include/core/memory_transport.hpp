@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "byte_ring.hpp"
+#include "transport.hpp"
+
+// In-process transport: two endpoints joined by a pair of SPSC byte rings,
+// one per direction, so a hop costs two memcpys instead of a trip through
+// the kernel. The endpoints may live on different io threads. Data moves
+// lock-free; only a side that has to wait for data or room parks its
+// operation, and the other side posts the wakeup to its executor.
+class MemoryTransport : public Transport
+{
+public:
+    static constexpr std::size_t kDefaultCapacity = 16 * 1024;
+
+    // Ring capacity is per direction and rounded up to a power of two
+    static std::pair<std::unique_ptr<MemoryTransport>, std::unique_ptr<MemoryTransport>>
+    make_pair(boost::asio::any_io_executor a, boost::asio::any_io_executor b,
+              std::size_t capacity = kDefaultCapacity);
+
+    ~MemoryTransport() override;
+
+    void async_read_some(boost::asio::mutable_buffer buffer, Handler handler) override;
+    void async_write(ConstBuffers buffers, Handler handler) override;
+    void close() override;
+    bool is_open() const override;
+
+    boost::asio::any_io_executor get_executor() override;
+    std::string remote() const override;
+
+private:
+    struct Shared;
+
+    MemoryTransport(std::shared_ptr<Shared> shared, int side);
+
+    // Progress a parked operation of `side`; on that side's thread
+    static void try_read_(const std::shared_ptr<Shared> &shared, int side);
+    static void try_write_(const std::shared_ptr<Shared> &shared, int side);
+
+    std::shared_ptr<Shared> shared_;
+    int side_;
+};
@@ -3,20 +3,50 @@
 #include <vector>
 #include <cstring>
 
+// With duplicate suppression in the router the TTL only has to cover the
+// network diameter, not bound the flood
+constexpr uint16_t kDefaultTtl = 16;
+
 enum class MessageType : uint16_t
 {
-    Data = 1
+    Data = 1,
+    // First frame on every connection, src_node_id names the sender and the
+    // body holds the newest wire version it reads. Control frames are
+    // handled by the connection and never routed.
+    Hello = 2,
+    // Liveness probe on a link we have not heard from, answered by a Pong;
+    // neither has a body
+    Ping = 3,
+    Pong = 4
+};
+
+// MessageHeader::flags
+enum MessageFlags : uint8_t
+{
+    // The body starts with a TraceExtension; every hop records trace events
+    kFlagTraced = 0x01
 };
 
+// In-memory header; wire.hpp encodes it. The fixed wire format keeps this
+// layout, in little-endian.
 #pragma pack(push, 1)
 struct MessageHeader
 {
-    uint8_t version{1};
+    uint8_t version{1}; // wire version it arrived in
     uint16_t type{0};
     uint64_t src_node_id{0};
     uint64_t dst_node_id{0};
-    uint32_t size{0};
+    uint32_t seq{0}; // per-source sequence id, (src_node_id, seq) is unique
+    uint32_t size{0}; // body bytes, extensions included
     uint16_t ttl{0};
+    uint8_t flags{0};
+};
+
+// Encoded by wire.hpp, little-endian like the header
+struct TraceExtension
+{
+    uint64_t trace_id;
+    uint64_t origin_ns; // steady clock at the source
 };
 #pragma pack(pop)
 
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Monotonic counter with a single writer (the owning io thread) and any
+// number of readers. The writer uses a plain load/store instead of a locked
+// read-modify-write, so counting on the hot path costs no more than an add.
+class Counter
+{
+public:
+    void add(uint64_t n = 1) { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Last written level of something, e.g. a queue depth; same threading as Counter
+class Gauge
+{
+public:
+    void set(uint64_t v) { value_.store(v, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+struct RouterStats
+{
+    uint64_t received = 0;    // frames handed to the router by connections
+    uint64_t duplicates = 0;  // already seen or our own, discarded
+    uint64_t delivered = 0;   // addressed to this node
+    uint64_t forwarded = 0;   // relayed toward other nodes, once per message
+    uint64_t originated = 0;  // sent by this node
+    uint64_t ttl_expired = 0; // not relayed because the TTL ran out
+    uint64_t dropped = 0;     // frames lost to full write queues or failed connections
+};
+
+struct ConnectionStats
+{
+    uint32_t id = 0;    // PeerConnection::id(), fixed for the connection's life
+    std::string remote; // peer endpoint, "?" when unknown
+    std::optional<uint64_t> node_id; // remote node, once the handshake is done
+    bool open = true;
+    bool standby = false; // duplicate link to a node, kept for failover
+    uint64_t frames_in = 0;
+    uint64_t bytes_in = 0;
+    uint64_t frames_out = 0;
+    uint64_t bytes_out = 0;
+    uint64_t writes = 0; // gather writes, frames_out / writes is the batch size
+    uint64_t dropped = 0;
+    uint64_t queued_frames = 0;
+    uint64_t queued_bytes = 0;
+};
+
+// Point-in-time view of a Node, see Node::stats()
+struct NodeStats
+{
+    uint64_t id = 0;
+    RouterStats routing;
+
+    // Sums over the connections below
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t queued_frames = 0;
+    uint64_t queued_bytes = 0;
+
+    std::vector<ConnectionStats> connections;
+};
+
+// Prometheus text exposition format (version 0.0.4)
+void write_prometheus(std::ostream &out, const std::vector<NodeStats> &nodes);
@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+// Unbounded lock-free multi-producer single-consumer queue (Vyukov).
+// push() may be called from any thread, pop() only from the consumer.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+        : head_(new Cell), tail_(head_.load(std::memory_order_relaxed)) {}
+
+    ~MpscQueue()
+    {
+        while (tail_)
+        {
+            Cell *next = tail_->next.load(std::memory_order_relaxed);
+            delete tail_;
+            tail_ = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    void push(T value)
+    {
+        Cell *cell = new Cell{std::move(value)};
+        Cell *prev = head_.exchange(cell, std::memory_order_acq_rel);
+        prev->next.store(cell, std::memory_order_release);
+    }
+
+    // False when empty, or when a producer has not finished linking its cell
+    bool pop(T &out)
+    {
+        Cell *next = tail_->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+
+        // The popped cell becomes the new sentinel
+        out = std::move(next->value);
+        delete tail_;
+        tail_ = next;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        T value{};
+        std::atomic<Cell *> next{nullptr};
+    };
+
+    std::atomic<Cell *> head_;
+    Cell *tail_;
+};
@@ -1,19 +1,67 @@
 #pragma once
 #include <boost/asio.hpp>
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
 
+#include "buffer_pool.hpp"
+#include "io_pool.hpp"
+#include "local_transport.hpp"
+#include "memory_transport.hpp"
+#include "metrics.hpp"
+#include "mpsc_queue.hpp"
+#include "peer_connection.hpp"
 #include "peer_manager.hpp"
 #include "router.hpp"
+#include "socket_tuning.hpp"
 
 using boost::asio::ip::tcp;
 
+// A message addressed to this node. The payload points into the receive
+// buffer and is only valid during the handler call; retain() makes an owning
+// copy for consumers that keep the message around.
+struct Delivery
+{
+    const MessageHeader &header;
+    Span<const uint8_t> payload;
+
+    FramePtr retain() const;
+};
+
+// Redialing of outbound connections that failed or were lost. The delay
+// doubles per failed attempt, with jitter so a mesh does not redial in step.
+struct ReconnectPolicy
+{
+    bool enabled = false;
+    std::chrono::milliseconds initial_delay{100};
+    std::chrono::milliseconds max_delay{30000};
+};
+
+// Where an outbound connection goes
+using DialTarget = std::variant<tcp::endpoint, LocalEndpoint>;
+
 class Node
 {
 public:
+    using DeliveryHandler = std::function<void(uint64_t node_id, const Delivery &delivery)>;
+    // Convenience signature, adapted onto DeliveryHandler at one copy per message
     using ReceiveHandler = std::function<void(uint64_t node_id, uint64_t from_id, const std::string &message)>;
 
-    Node(uint64_t id, uint16_t port);
+    // Without a port the node does not listen and is only reachable through
+    // connect(Node &). The tuning applies to every TCP socket of the node
+    // and places its io thread.
+    Node(uint64_t id, std::optional<uint16_t> port, const SocketTuning &tuning = {});
+    // Shared executor mode: the node lives on one of the pool's io threads,
+    // which the pool places; only the socket options of `tuning` apply
+    Node(uint64_t id, std::optional<uint16_t> port, IoPool &pool, const SocketTuning &tuning = {});
     ~Node();
 
     Node(const Node &) = delete;
@@ -23,27 +71,109 @@ public:
 
     void run();
     void connect(const tcp::endpoint &ep);
+    // Same-host link to a node listening on ep.path, over the socket itself
+    // or over shared memory set up through it
+    void connect(const LocalEndpoint &ep);
+    // Also accept local:// and shm:// links on an AF_UNIX socket at `path`.
+    // A stale socket file is replaced; the file is removed with the node.
+    void listen_local(const std::string &path);
+    // In-process link over a MemoryTransport, no sockets involved
+    void connect(Node &peer, std::size_t capacity = MemoryTransport::kDefaultCapacity);
     void send(uint64_t dst, std::string_view data);
     void set_receive_handler(ReceiveHandler handler);
+    void set_delivery_handler(DeliveryHandler handler);
+    void set_routing_mode(RoutingMode mode) { router_.set_mode(mode); }
+    // TTL of messages sent after the call; must cover the network diameter
+    void set_ttl(uint16_t ttl) { ttl_.store(ttl, std::memory_order_relaxed); }
+    // Applies to connections established after the call
+    void set_connection_options(const ConnectionOptions &options);
+    void set_reconnect_policy(const ReconnectPolicy &policy);
+
+    // From the router on the io thread: forget the connection, maybe redial
+    void on_peer_closed(PeerConnection *peer);
 
-    // Get the receive handler for router to use
-    const ReceiveHandler &get_receive_handler() const { return receive_handler_; }
+    // Get the delivery handler for router to use
+    const DeliveryHandler &get_delivery_handler() const { return delivery_handler_; }
 
     uint64_t get_id() const { return id_; }
+    // 0 when not listening
+    uint16_t get_port() const;
+    // Empty when not listening locally
+    const std::string &local_path() const { return local_path_; }
+    const SocketTuning &tuning() const { return tuning_; }
+    uint64_t dropped() const { return router_.dropped(); }
+    uint64_t ttl_expired() const { return router_.ttl_expired(); }
+
+    // Counters and queue depths of the node and each of its connections.
+    // Callable from any thread, also when the io thread is not running.
+    NodeStats stats();
+
+    // Frame storage; only touched on the io thread
+    BufferPool &buffer_pool() { return buffer_pool_; }
 
 private:
+    Node(uint64_t id, std::optional<uint16_t> port, const SocketTuning &tuning,
+         std::unique_ptr<boost::asio::io_context> own_io, boost::asio::io_context *shared_io);
+
     void accept_loop();
+    void local_accept_loop_();
+    void read_preamble_(std::shared_ptr<local_socket> socket);
+    std::shared_ptr<PeerConnection> adopt_(std::unique_ptr<Transport> transport,
+                                           std::size_t max_read_buffer = SIZE_MAX);
+    void dial_(const DialTarget &target, unsigned attempt);
+    void dial_local_(const LocalEndpoint &ep, unsigned attempt);
+    void dial_failed_(const DialTarget &target, unsigned attempt, const std::string &error);
+    void redial_(const DialTarget &target, unsigned attempt);
+    void drain_submissions_();
     static void default_receive_handler(uint64_t node_id, uint64_t from_id, const std::string &message);
 
-    boost::asio::io_context io_;
+    // First member: frames still referenced while the io_context and the
+    // peers are torn down give their blocks back to a live pool
+    BufferPool buffer_pool_;
+
+    // PeerConnections not yet destroyed, whichever thread drops the last
+    // reference. On a shared context the destructor waits for zero: until
+    // then a completion may still reach the router or return frames.
+    std::mutex connections_mutex_;
+    std::condition_variable connections_gone_;
+    std::size_t live_connections_{0};
+
+    // For the one drain that can be queued. Declared before own_io_, whose
+    // destructor frees an op still queued in it.
+    HandlerMemory drain_memory_;
+
+    // Set only when the node drives its own io_context and thread
+    std::unique_ptr<boost::asio::io_context> own_io_;
+    boost::asio::io_context &io_;
     tcp::acceptor acceptor_;
+    boost::asio::local::stream_protocol::acceptor local_acceptor_;
+    std::string local_path_;
 
     PeerManager peers_;
     Router router_;
 
     uint64_t id_;
+    SocketTuning tuning_;
+    std::atomic<uint32_t> next_seq_{0};
+    std::atomic<uint16_t> ttl_{kDefaultTtl};
+    std::atomic<bool> block_when_congested_{false};
+
+    // Messages sent from other threads, drained in batches on the io thread
+    MpscQueue<Message> submissions_;
+    std::atomic<bool> drain_scheduled_{false};
+
+    DeliveryHandler delivery_handler_;
+    ConnectionOptions connection_options_;
 
-    ReceiveHandler receive_handler_;
+    // Connection lifecycle, io thread only
+    ReconnectPolicy reconnect_;
+    std::unordered_map<const PeerConnection *, DialTarget> outbound_;
+    std::unordered_set<std::shared_ptr<tcp::socket>> dialing_;
+    // Local sockets being dialed or waiting for their preamble
+    std::unordered_set<std::shared_ptr<local_socket>> local_pending_;
+    std::unordered_set<std::shared_ptr<boost::asio::steady_timer>> redial_timers_;
+    std::minstd_rand jitter_;
+    bool stopping_{false};
 
     std::thread thread_;
     boost::asio::executor_work_guard<
@@ -1,34 +1,141 @@
 #pragma once
-#include <deque>
+#include <atomic>
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <string>
 #include <vector>
 #include <boost/asio.hpp>
 
+#include "frame.hpp"
 #include "message.hpp"
-
-using boost::asio::ip::tcp;
+#include "metrics.hpp"
+#include "peer_manager.hpp"
+#include "ring_queue.hpp"
+#include "trace.hpp"
+#include "transport.hpp"
 
 class Router;
 
+// What to do when a peer's write queue is full
+enum class OverflowPolicy
+{
+    Block,      // Node::send waits for room; relayed frames are dropped
+    DropOldest, // discard the oldest frames not yet being written
+    DropNewest, // discard the frame being queued
+    Disconnect  // close the slow peer and discard its queue
+};
+
+struct ConnectionOptions
+{
+    // Caps for the frames drained into a single gather write
+    std::size_t max_batch_bytes = 256 * 1024;
+    std::size_t max_batch_frames = 64;
+
+    // Nagle-like delay before writing into an idle socket, letting more
+    // frames join the batch; zero writes immediately
+    std::chrono::microseconds coalesce_window{0};
+
+    // Receive buffer; grows only for frames that are larger
+    std::size_t read_buffer_size = 64 * 1024;
+    // A peer announcing a larger body is closed instead of buffered
+    std::size_t max_frame_size = 16 * 1024 * 1024;
+
+    // Write queue limits per connection
+    std::size_t max_queue_bytes = 16 * 1024 * 1024;
+    std::size_t max_queue_frames = 64 * 1024;
+    OverflowPolicy overflow_policy = OverflowPolicy::DropNewest;
+
+    // A Ping goes out after an interval without hearing from the peer; a
+    // link that stays silent for idle_timeout is closed as half-open. Zero
+    // disables.
+    std::chrono::milliseconds heartbeat_interval{5000};
+    std::chrono::milliseconds idle_timeout{15000};
+};
+
 class PeerConnection : public std::enable_shared_from_this<PeerConnection>
 {
 public:
-    explicit PeerConnection(tcp::socket socket, Router &router);
+    PeerConnection(std::unique_ptr<Transport> transport, Router &router, const ConnectionOptions &options = {});
     void start();
-    void async_send(const Message &msg);
+    void async_send(FramePtr frame);
+
+    // Drops the queue and closes the socket; the router hears about it once
+    void close();
+
+    // Safe to read from any thread
+    std::size_t queued_bytes() const { return queued_bytes_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.value(); }
+    // Without node_id, which only the io thread may read; see PeerManager::links()
+    ConnectionStats stats() const;
 
-    tcp::socket &socket() { return socket_; }
+    // Process-wide unique, names the connection in traces
+    uint32_t id() const { return id_; }
+
+    // Node at the other end, known once its Hello arrived; io thread only
+    const std::optional<uint64_t> &remote_id() const { return remote_id_; }
+    bool failed() const { return failed_.load(std::memory_order_relaxed); }
 
 private:
-    void read_header_();
-    void read_body_();
+    friend class PeerManager;
+
+    void read_some_();
+    void on_read_(boost::system::error_code ec, std::size_t n);
+    void on_write_(boost::system::error_code ec, std::size_t n);
+    void parse_frames_();
+    void handle_control_(const MessageHeader &header, Span<const uint8_t> body);
     void write_next_();
+    void schedule_write_();
+    void heartbeat_();
+    void send_control_(MessageType type);
 
-    tcp::socket socket_;
+    bool has_room_(std::size_t frame_size) const;
+    bool full_() const;
+    bool make_room_(std::size_t frame_size);
+    void drop_(std::size_t frames);
+    void set_congested_(bool congested);
+    void fail_();
+    void trace_(TraceStage stage, const Frame &frame, uint64_t ts_ns = 0);
+
+    std::unique_ptr<Transport> transport_;
     Router &router_;
+    ConnectionOptions options_;
+    std::string remote_;
+    uint32_t id_;
+    std::optional<uint64_t> remote_id_;
+    PeerSlot slot_; // maintained by the node's PeerManager
+
+    // Received bytes not yet parsed live in [read_begin_, read_end_)
+    std::vector<uint8_t> read_buffer_;
+    std::size_t read_begin_{0};
+    std::size_t read_end_{0};
+    uint64_t read_ts_{0}; // completion time of the last read, while tracing
+
+    // Header encoding of what we write: fixed until the peer's Hello
+    // announces that it reads compact headers too
+    uint8_t wire_version_{kWireFixed};
+
+    RingQueue<FramePtr> write_queue_;
+    std::vector<boost::asio::const_buffer> write_buffers_;
+    std::size_t in_flight_{0}; // frames at the front of write_queue_ being written
+    bool writing_{false};
+    bool coalescing_{false};
+    HandlerMemory coalesce_memory_; // outlives the timer's operation
+    boost::asio::steady_timer coalesce_timer_;
+
+    boost::asio::steady_timer heartbeat_timer_;
+    bool heard_{false};                        // something was read since the last tick
+    std::chrono::milliseconds silent_for_{0}; // nothing read for this long
 
-    MessageHeader header_;
-    std::vector<uint8_t> body_;
+    std::atomic<std::size_t> queued_bytes_{0};
+    Gauge queued_frames_;
+    bool congested_{false};
+    std::atomic<bool> failed_{false};
 
-    std::deque<std::vector<uint8_t>> write_queue_;
+    Counter frames_in_;
+    Counter bytes_in_;
+    Counter frames_out_;
+    Counter bytes_out_;
+    Counter writes_;
+    Counter dropped_;
 };
@@ -1,22 +1,88 @@
 #pragma once
-#include <unordered_set>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 class PeerConnection;
 
+// A connection's place in its PeerManager, kept on the connection itself so
+// removal needs no search
+struct PeerSlot
+{
+    static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+    uint32_t link = npos;   // index in links_
+    uint32_t active = npos; // index in active_, npos while standing by
+    bool filed = false;     // listed under its node in by_node_
+};
+
+// Connections of a node, grouped by the remote node once its Hello arrived.
+// Several sockets to the same node (e.g. dialed both ways, or through two
+// addresses) form one peer: traffic goes over its first link and the others
+// stand by until that one is removed.
+//
+// Both lists are dense vectors with swap-remove, so fan-out walks contiguous
+// memory and add/remove are O(1) apart from the per-node link list.
 class PeerManager
 {
 public:
+    // A connection as other threads see it, see links()
+    struct LinkInfo
+    {
+        std::shared_ptr<PeerConnection> peer;
+        std::optional<uint64_t> node_id; // once identified
+        bool standby = false;
+    };
+
     void add(std::shared_ptr<PeerConnection> peer);
     void remove(PeerConnection *peer);
 
+    // Files the connection under the remote node id from its handshake.
+    // Returns false when the node already has a link and this one stands by.
+    bool identify(PeerConnection *peer, uint64_t node_id);
+
+    // Link in use to a directly connected node, or nullptr
+    std::shared_ptr<PeerConnection> find(uint64_t node_id) const;
+
+    // One link per remote node, plus connections still handshaking
     template <typename Fn>
     void for_each(Fn &&fn)
     {
-        for (auto &p : peers_)
+        for (auto &p : active_)
+            fn(p);
+    }
+
+    // Every connection, standby links included
+    template <typename Fn>
+    void for_each_link(Fn &&fn)
+    {
+        for (auto &p : links_)
             fn(p);
     }
 
+    // Copy of every connection as of the last add, remove or identify.
+    // Safe to call from any thread; the other members are io thread only.
+    std::vector<LinkInfo> links() const;
+
+    std::size_t size() const { return links_.size(); }
+    std::size_t neighbours() const { return by_node_.size(); }
+
 private:
-    std::unordered_set<std::shared_ptr<PeerConnection>> peers_;
+    void activate_(const std::shared_ptr<PeerConnection> &peer);
+    void deactivate_(PeerConnection *peer);
+    void publish_();
+
+    std::vector<std::shared_ptr<PeerConnection>> links_;
+    std::vector<std::shared_ptr<PeerConnection>> active_;
+
+    // links.front() is the one in active_
+    std::unordered_map<uint64_t, std::vector<std::shared_ptr<PeerConnection>>> by_node_;
+
+    // Rebuilt on every change, which is rare next to reads of the lists
+    mutable std::mutex published_mtx_;
+    std::vector<LinkInfo> published_;
 };
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Growable circular queue. Unlike std::deque it never allocates once it has
+// reached its working size, which keeps steady-state writes allocation free.
+template <typename T>
+class RingQueue
+{
+public:
+    explicit RingQueue(std::size_t capacity = 16)
+    {
+        std::size_t cap = 1;
+        while (cap < capacity)
+            cap <<= 1;
+        slots_.resize(cap);
+    }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T &operator[](std::size_t i) { return slots_[(head_ + i) & (slots_.size() - 1)]; }
+    const T &operator[](std::size_t i) const { return slots_[(head_ + i) & (slots_.size() - 1)]; }
+    T &front() { return (*this)[0]; }
+
+    void push_back(T value)
+    {
+        if (size_ == slots_.size())
+            grow_();
+        (*this)[size_] = std::move(value);
+        ++size_;
+    }
+
+    void pop_front(std::size_t n = 1)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            front() = T{};
+            head_ = (head_ + 1) & (slots_.size() - 1);
+        }
+        size_ -= n;
+    }
+
+    // Removes count elements starting at index first
+    void erase(std::size_t first, std::size_t count)
+    {
+        for (std::size_t i = first; i + count < size_; ++i)
+            (*this)[i] = std::move((*this)[i + count]);
+        truncate(size_ - count);
+    }
+
+    // Keeps only the first n elements
+    void truncate(std::size_t n)
+    {
+        for (std::size_t i = n; i < size_; ++i)
+            (*this)[i] = T{};
+        size_ = n;
+    }
+
+private:
+    void grow_()
+    {
+        std::vector<T> bigger(slots_.size() * 2);
+        for (std::size_t i = 0; i < size_; ++i)
+            bigger[i] = std::move((*this)[i]);
+        slots_ = std::move(bigger);
+        head_ = 0;
+    }
+
+    std::vector<T> slots_;
+    std::size_t head_{0};
+    std::size_t size_{0};
+};
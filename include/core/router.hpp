@@ -1,23 +1,81 @@
 #pragma once
+#include <atomic>
 #include <cstdint>
 
+#include "frame.hpp"
 #include "message.hpp"
+#include "metrics.hpp"
+#include "routing_table.hpp"
+#include "seen_cache.hpp"
 
 class PeerConnection;
 class PeerManager;
 class Node;
 
+enum class RoutingMode
+{
+    Flood,  // every peer except the sender
+    Learned // learned next hop, flooding only unknown destinations
+};
+
 class Router
 {
 public:
     Router(uint64_t self_id, PeerManager &peers, Node &node);
 
-    void on_message(Message msg, PeerConnection *from);
+    // The body view is only valid for the duration of the call
+    void on_message(const MessageHeader &header, Span<const uint8_t> body, PeerConnection *from);
+
+    // Route a message produced by this node
+    void originate(const Message &msg);
+
+    // Handshake completed on a connection; false if it duplicates another link
+    bool on_hello(PeerConnection *from, uint64_t node_id);
+
+    // The connection failed or was closed; called once per connection
+    void on_closed(PeerConnection *peer);
+
+    // Flow-control feedback from the connections, on the io thread
+    void on_dropped(std::size_t frames) { dropped_.add(frames); }
+    void on_congestion(bool congested) { congested_peers_.fetch_add(congested ? 1 : -1, std::memory_order_relaxed); }
+
+    // Frames lost to full write queues or failed connections
+    uint64_t dropped() const { return dropped_.value(); }
+    // Messages not relayed because their TTL ran out
+    uint64_t ttl_expired() const { return ttl_expired_.value(); }
+    bool congested() const { return congested_peers_.load(std::memory_order_relaxed) > 0; }
+
+    void set_mode(RoutingMode mode) { mode_.store(mode, std::memory_order_relaxed); }
+    RoutingMode mode() const { return mode_.load(std::memory_order_relaxed); }
+
+    // Safe to call from any thread
+    RouterStats stats() const;
+
+    uint64_t self_id() const { return self_id_; }
 
 private:
-    void forward(Message &msg, PeerConnection *from);
+    // The frame is encoded once and shared by every peer it fans out to
+    void forward(const FramePtr &frame, PeerConnection *from);
+    // Whether the peer leads back to the node `from` connects to
+    static bool same_node_(const PeerConnection &peer, const PeerConnection *from);
 
     uint64_t self_id_;
     PeerManager &peers_;
     Node &node_;
+
+    // Each (src, seq) is delivered and forwarded at most once
+    SeenCache seen_;
+
+    std::atomic<RoutingMode> mode_{RoutingMode::Flood};
+    RoutingTable routes_;
+
+    std::atomic<int> congested_peers_{0};
+
+    Counter received_;
+    Counter duplicates_;
+    Counter delivered_;
+    Counter forwarded_;
+    Counter originated_;
+    Counter ttl_expired_;
+    Counter dropped_;
 };
@@ -0,0 +1,36 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+class PeerConnection;
+
+// Next hop toward each node, learned from the reverse path of its traffic.
+// With duplicate suppression only the first copy of a message is seen, so
+// the learned peer is the one on the fastest path from that node.
+class RoutingTable
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit RoutingTable(std::chrono::milliseconds max_age = std::chrono::seconds(30));
+
+    void learn(uint64_t node_id, const std::shared_ptr<PeerConnection> &via);
+
+    // Returns the next hop, or nullptr when unknown, stale or disconnected
+    std::shared_ptr<PeerConnection> lookup(uint64_t node_id);
+
+    void clear() { routes_.clear(); }
+    std::size_t size() const { return routes_.size(); }
+
+private:
+    struct Route
+    {
+        std::weak_ptr<PeerConnection> via;
+        clock::time_point updated;
+    };
+
+    std::unordered_map<uint64_t, Route> routes_;
+    std::chrono::milliseconds max_age_;
+};
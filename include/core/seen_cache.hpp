@@ -0,0 +1,49 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Bounded set of recently seen (src_node_id, seq) pairs.
+// Entries live in a FIFO ring and are evicted when the ring is full or when
+// they are older than max_age; an open-addressing index makes lookups O(1).
+// The ring starts small and doubles up to `capacity`, so idle nodes of a
+// large simulated mesh stay cheap.
+class SeenCache
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit SeenCache(std::size_t capacity = 8192,
+                       std::chrono::milliseconds max_age = std::chrono::seconds(30));
+
+    // Returns true if the pair was already seen, records it otherwise
+    bool check_and_insert(uint64_t src, uint32_t seq);
+
+    std::size_t size() const { return count_; }
+
+private:
+    struct Entry
+    {
+        uint64_t src;
+        uint32_t seq;
+        clock::time_point seen;
+    };
+
+    static uint64_t hash_(uint64_t src, uint32_t seq);
+
+    std::size_t find_slot_(uint64_t src, uint32_t seq) const;
+    void evict_oldest_();
+    void erase_slot_(std::size_t slot);
+    void resize_(std::size_t ring_size);
+
+    std::size_t capacity_;
+    std::vector<Entry> ring_;
+    std::size_t head_{0};
+    std::size_t count_{0};
+
+    // Ring index + 1 per slot, 0 marks an empty slot
+    std::vector<uint32_t> index_;
+    std::size_t mask_;
+
+    std::chrono::milliseconds max_age_;
+};
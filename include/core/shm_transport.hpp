@@ -0,0 +1,50 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "local_transport.hpp"
+
+// Transport between processes on one host: a memfd segment holding two SPSC
+// byte rings, one per direction, like MemoryTransport across a process
+// boundary. A side that must wait for data or room parks on its own eventfd,
+// which the other side writes only when it finds the side parked. The
+// AF_UNIX socket the link was set up over stays open to notice the peer
+// process going away.
+class ShmTransport : public Transport
+{
+public:
+    static constexpr std::size_t kDefaultCapacity = 1 << 20;
+
+    // Dialing side: creates the segment and eventfds and passes them in the
+    // preamble. Capacity is per direction, rounded up to a power of two.
+    static std::unique_ptr<ShmTransport> dial(local_socket control, std::string remote,
+                                              std::size_t capacity = kDefaultCapacity);
+    // Accepting side: maps what the preamble carried (segment, wakeup of the
+    // dialer, own wakeup) and takes ownership of the fds
+    static std::unique_ptr<ShmTransport> attach(local_socket control, std::vector<int> fds, std::string remote);
+
+    ~ShmTransport() override;
+
+    void async_read_some(boost::asio::mutable_buffer buffer, Handler handler) override;
+    void async_write(ConstBuffers buffers, Handler handler) override;
+    void close() override;
+    bool is_open() const override;
+
+    boost::asio::any_io_executor get_executor() override;
+    std::string remote() const override;
+
+private:
+    struct State;
+
+    explicit ShmTransport(std::shared_ptr<State> state);
+
+    static void try_read_(const std::shared_ptr<State> &state);
+    static void try_write_(const std::shared_ptr<State> &state);
+    // Waits on our eventfd for the peer to make progress
+    static void wait_(const std::shared_ptr<State> &state);
+    // Waits for the control socket to hang up
+    static void watch_(const std::shared_ptr<State> &state);
+
+    std::shared_ptr<State> state_;
+};
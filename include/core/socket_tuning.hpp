@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+using boost::asio::ip::tcp;
+
+// Socket options of a node's TCP links and placement of its io thread.
+// Relay links carry small frames that must not wait for Nagle and delayed
+// ACKs, so TCP_NODELAY is on by default; every other default leaves the
+// choice to the kernel and the scheduler.
+struct SocketTuning
+{
+    bool no_delay = true;       // TCP_NODELAY: no Nagle delay for small frames
+    int send_buffer = 0;        // SO_SNDBUF bytes, 0 keeps the kernel's
+    int receive_buffer = 0;     // SO_RCVBUF bytes, 0 keeps the kernel's
+    int busy_poll_us = 0;       // SO_BUSY_POLL, may need CAP_NET_ADMIN
+    bool reuse_port = false;    // SO_REUSEPORT on the listening socket
+    std::vector<unsigned> cpus; // io threads are pinned round-robin to these
+    int numa_node = -1;         // with no cpus: that node's CPUs; memory prefers it
+
+    // Comma-separated options, e.g. "rcvbuf=262144,busy_poll=50,cpu=0-3".
+    // Tokens: nagle (TCP_NODELAY off), nodelay (the default), sndbuf=BYTES,
+    // rcvbuf=BYTES, busy_poll=USEC, reuseport, cpu=N or cpu=A-B
+    // (repeatable), numa=N; "default" for none.
+    // Throws std::invalid_argument.
+    static SocketTuning parse(const std::string &spec);
+    // Inverse of parse(); "default" when nothing differs from the defaults
+    std::string describe() const;
+
+    bool places_threads() const { return !cpus.empty() || numa_node >= 0; }
+};
+
+// Before connect(). Options the kernel refuses are logged, not thrown.
+void apply_tuning(tcp::socket &socket, const SocketTuning &tuning);
+// Before bind(); accepted sockets inherit the buffer sizes
+void apply_tuning(tcp::acceptor &acceptor, const SocketTuning &tuning);
+
+// Pins the calling thread to the index-th of the tuning's CPUs and sets its
+// memory policy; no-op when the tuning places nothing
+void place_thread(const SocketTuning &tuning, std::size_t index);
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+
+// Minimal non-owning view over contiguous memory (std::span is C++20)
+template <typename T>
+class Span
+{
+public:
+    // Enough of a container for algorithms and asio buffer sequences
+    using value_type = std::remove_cv_t<T>;
+    using iterator = T *;
+    using const_iterator = T *;
+
+    constexpr Span() = default;
+    constexpr Span(T *data, std::size_t size) : data_(data), size_(size) {}
+
+    // Any contiguous container with data() and size(), e.g. vector or string
+    template <typename Container,
+              typename = std::enable_if_t<std::is_convertible_v<
+                  decltype(std::declval<Container &>().data()), T *>>>
+    constexpr Span(Container &c) : data_(c.data()), size_(c.size()) {}
+
+    constexpr T *data() const { return data_; }
+    constexpr std::size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+
+    constexpr T *begin() const { return data_; }
+    constexpr T *end() const { return data_ + size_; }
+    constexpr T &operator[](std::size_t i) const { return data_[i]; }
+
+    constexpr Span subspan(std::size_t offset) const { return {data_ + offset, size_ - offset}; }
+
+private:
+    T *data_{nullptr};
+    std::size_t size_{0};
+};
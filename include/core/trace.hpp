@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "message.hpp"
+#include "span.hpp"
+
+// Points along a traced message's path through one node
+enum class TraceStage : uint8_t
+{
+    Originate,     // Node::send on the source
+    ReadComplete,  // the read that completed the frame returned
+    Deliver,       // routed to the local delivery handler
+    Forward,       // routed onward
+    Duplicate,     // discarded as already seen
+    Expired,       // discarded, TTL ran out
+    Enqueue,       // queued on a connection
+    WriteComplete  // the write carrying it finished
+};
+
+struct TraceEvent
+{
+    uint64_t ts_ns;
+    uint64_t trace_id;
+    uint64_t node_id;
+    uint32_t conn_id; // 0 for router stages
+    TraceStage stage;
+};
+
+// Sampled per-message tracing. The source marks one in N messages with
+// kFlagTraced and a TraceExtension; every hop then records its stages into
+// a ring owned by the recording thread, so recording takes no locks. Rings
+// keep the newest events and are read back by snapshot() for export.
+class Tracer
+{
+public:
+    static Tracer &instance();
+
+    // Trace one in `one_in` messages; 0 turns tracing off
+    void set_sample_rate(uint32_t one_in);
+    uint32_t sample_rate() const { return sample_rate_.load(std::memory_order_relaxed); }
+
+    // Cheap check guarding all recording work
+    static bool enabled() { return instance().sample_rate() != 0; }
+
+    // Sampling decision for the next message originated on this thread
+    bool sample();
+
+    static uint64_t now_ns();
+    // Never 0, which trace_id_of() and the recorders read as untraced
+    static uint64_t make_trace_id(uint64_t src, uint32_t seq)
+    {
+        return ((src << 32) ^ seq) | (uint64_t{1} << 63);
+    }
+
+    // Trace id of a traced frame body, 0 if the body is not traced
+    static uint64_t trace_id_of(const MessageHeader &header, Span<const uint8_t> body);
+
+    void record(TraceStage stage, uint64_t trace_id, uint64_t node_id, uint32_t conn_id = 0,
+                uint64_t ts_ns = 0);
+
+    // Events of all threads, oldest first. Read while tracing is off: rings
+    // that are still being written may yield torn events.
+    std::vector<TraceEvent> snapshot() const;
+    void clear();
+
+    // Chrome trace event format, loadable in chrome://tracing and Perfetto.
+    // One process per node; the router lane holds read->route spans, one
+    // lane per connection holds enqueue->write-complete spans.
+    static void write_chrome_json(std::ostream &out, const std::vector<TraceEvent> &events);
+
+private:
+    struct Ring;
+    Ring &local_ring_();
+
+    std::atomic<uint32_t> sample_rate_{0};
+
+    mutable std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<Ring>> rings_;
+};
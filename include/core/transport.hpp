@@ -0,0 +1,71 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+
+#include "completion_handler.hpp"
+#include "handler_memory.hpp"
+#include "span.hpp"
+
+using boost::asio::ip::tcp;
+
+// Byte stream under a PeerConnection. Completion handlers run on the
+// transport's executor, never inside the initiating call. At most one read
+// and one write are outstanding at a time; both the buffer array passed to
+// a write and the bytes it points to must stay valid until its handler
+// runs, so transports can use the caller's array instead of copying it.
+class Transport
+{
+public:
+    using Handler = CompletionHandler;
+    using ConstBuffers = Span<const boost::asio::const_buffer>;
+
+    virtual ~Transport() = default;
+
+    virtual void async_read_some(boost::asio::mutable_buffer buffer, Handler handler) = 0;
+    // Completes once every buffer is written, like boost::asio::async_write
+    virtual void async_write(ConstBuffers buffers, Handler handler) = 0;
+    // Pending operations complete with operation_aborted
+    virtual void close() = 0;
+    virtual bool is_open() const = 0;
+
+    virtual boost::asio::any_io_executor get_executor() = 0;
+    // Human readable far end, e.g. "127.0.0.1:9000"
+    virtual std::string remote() const = 0;
+};
+
+// Block for a socket transport's writes: the operation behind
+// boost::asio::async_write carries an array of iovecs
+constexpr std::size_t kWriteMemory = 1024;
+
+class TcpTransport : public Transport
+{
+public:
+    explicit TcpTransport(tcp::socket socket);
+
+    void async_read_some(boost::asio::mutable_buffer buffer, Handler handler) override;
+    void async_write(ConstBuffers buffers, Handler handler) override;
+    void close() override;
+    bool is_open() const override { return socket_.is_open(); }
+
+    boost::asio::any_io_executor get_executor() override { return socket_.get_executor(); }
+    std::string remote() const override { return remote_; }
+
+private:
+    // Socket operations are allocated from these, not the heap; declared
+    // first so they outlive the socket
+    HandlerMemory read_memory_;
+    HandlerMemory write_memory_{kWriteMemory};
+    tcp::socket socket_;
+    std::string remote_;
+};
+
+// "ip:port" of the far end, "?" when unknown
+std::string describe_remote(const tcp::socket &socket);
+
+// Transport for a connected TCP socket on the active backend
+std::unique_ptr<Transport> make_tcp_transport(tcp::socket socket);
+
+// "io_uring" when built with RELAY_IO_URING, the kernel supports it and
+// RELAY_IO_BACKEND=epoll is not set in the environment; "epoll" otherwise
+const char *tcp_backend();
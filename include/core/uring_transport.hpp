@@ -0,0 +1,47 @@
+#pragma once
+#ifdef RELAY_IO_URING
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "transport.hpp"
+
+class UringService;
+
+// TCP transport driven by one io_uring per io_context instead of the epoll
+// reactor. Receives are multishot into a ring of kernel-registered buffers
+// (IORING_REGISTER_PBUF_RING), so a connection is armed once, not once per
+// read; sends are gathered sendmsg operations. Submissions queued while
+// handlers run go to the kernel in one io_uring_enter per batch, and
+// completions are reaped when the ring's eventfd wakes the io thread.
+class UringTransport : public Transport
+{
+public:
+    // nullptr when io_uring cannot be set up (old kernel, seccomp); the
+    // socket is left untouched for the caller to fall back on
+    static std::unique_ptr<UringTransport> make(tcp::socket &socket);
+
+    ~UringTransport() override;
+
+    void async_read_some(boost::asio::mutable_buffer buffer, Handler handler) override;
+    void async_write(ConstBuffers buffers, Handler handler) override;
+    void close() override;
+    bool is_open() const override;
+
+    boost::asio::any_io_executor get_executor() override;
+    std::string remote() const override;
+
+private:
+    friend class UringService;
+    struct State;
+
+    explicit UringTransport(std::shared_ptr<State> state);
+
+    static void try_read_(const std::shared_ptr<State> &state);
+    static void submit_send_(const std::shared_ptr<State> &state);
+    static void on_recv_(const std::shared_ptr<State> &state, int res, uint32_t flags);
+    static void on_send_(const std::shared_ptr<State> &state, int res);
+
+    std::shared_ptr<State> state_;
+};
+#endif
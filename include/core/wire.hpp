@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "message.hpp"
+
+// Wire encodings of MessageHeader. Every frame starts with its version byte,
+// so frames of both versions can share a stream.
+//
+// Version 1, fixed: 30 bytes laid out like MessageHeader, little-endian.
+// Version 2, compact: version, flags, then type, src, dst, seq, size and ttl
+// as LEB128 varints; about 10 bytes for small ids, sequence numbers and
+// bodies.
+constexpr uint8_t kWireFixed = 1;
+constexpr uint8_t kWireCompact = 2;
+// Newest version we speak; announced in our Hello
+constexpr uint8_t kWireVersion = kWireCompact;
+
+constexpr std::size_t kFixedHeaderSize = 30;
+constexpr std::size_t kMaxCompactHeaderSize = 2 + 3 + 10 + 10 + 5 + 5 + 3;
+constexpr std::size_t kMaxHeaderSize = kMaxCompactHeaderSize;
+static_assert(sizeof(MessageHeader) == kFixedHeaderSize, "fixed header mirrors MessageHeader");
+
+// Writes the header in `version` to out, which needs room for that
+// version's largest header; returns the bytes written. header.version is
+// ignored.
+std::size_t encode_header(const MessageHeader &header, uint8_t version, uint8_t *out);
+
+enum class WireStatus
+{
+    Ok,
+    Incomplete, // more bytes needed
+    Malformed   // unknown version or a varint out of range
+};
+
+// Decodes the header at the front of [data, data + n). On Ok, header_size is
+// its length on the wire and header.version the version it came in.
+WireStatus decode_header(const uint8_t *data, std::size_t n, MessageHeader &header, std::size_t &header_size);
+
+// TraceExtension at the front of a traced body: trace_id then origin_ns,
+// both little-endian. out and in hold sizeof(TraceExtension) bytes.
+void encode_trace_extension(const TraceExtension &ext, uint8_t *out);
+TraceExtension decode_trace_extension(const uint8_t *in);
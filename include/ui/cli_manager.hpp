@@ -1,10 +1,12 @@
 #pragma once
 #include <memory>
+#include <optional>
 #include <string>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 #include "core/node.hpp"
+#include "ui/metrics_server.hpp"
 
 // TODO: Load network from file
 
@@ -15,28 +17,49 @@ public:
     ~CliManager();
 
     void run();
-    void add_client(uint64_t id, uint16_t port);
+    // With a local path the client also accepts local:// and shm:// links
+    void add_client(uint64_t id, uint16_t port, const std::string &local_path = "",
+                    const SocketTuning &tuning = {});
     void connect_client(uint64_t client_id, const std::string &host, uint16_t port);
+    void connect_client(uint64_t client_id, const LocalEndpoint &ep);
     void send_message(uint64_t from_id, uint64_t to_id, const std::string &message);
     void list_clients();
     void stop_client(uint64_t id);
     void stop_all();
+    // 0 turns the pool off; the placement's cpu/numa pin the pool threads
+    void set_pool(std::size_t threads, const SocketTuning &placement = {});
+    void set_routing(uint64_t id, RoutingMode mode);
+    void set_coalesce(uint64_t id, std::chrono::microseconds window);
+    void set_queue_limits(uint64_t id, std::size_t max_bytes, std::size_t max_frames, OverflowPolicy policy);
+    void set_heartbeat(uint64_t id, std::chrono::milliseconds interval, std::chrono::milliseconds timeout);
+    void set_reconnect(uint64_t id, const ReconnectPolicy &policy);
+    void show_stats(std::optional<uint64_t> id = std::nullopt);
+    void serve_metrics(uint16_t port);
+    void stop_metrics();
+    void dump_metrics(const std::string &path);
+    void dump_trace(const std::string &path);
 
 private:
     struct ClientInfo
     {
         std::unique_ptr<Node> node;
-        std::unique_ptr<std::thread> thread;
+        ConnectionOptions options;
         boost::asio::io_context *io_context;
         uint64_t id;
         uint16_t port;
         bool running;
     };
 
+    // Declared before clients_ so nodes are torn down while the pool still runs
+    std::unique_ptr<IoPool> pool_;
     std::unordered_map<uint64_t, ClientInfo> clients_;
     std::mutex clients_mutex_;
     bool running_;
 
+    // Declared after clients_: scrapes read the nodes, so it goes first
+    std::unique_ptr<MetricsServer> metrics_;
+
+    std::string render_metrics();
     void print_help();
     void process_command(const std::string &command);
 };
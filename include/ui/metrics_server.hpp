@@ -0,0 +1,35 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+
+using boost::asio::ip::tcp;
+
+// Minimal HTTP endpoint for Prometheus scrapes: every request, whatever its
+// path, is answered with the text produced by `render`. Runs on its own
+// thread, bound to the loopback interface.
+class MetricsServer
+{
+public:
+    using Render = std::function<std::string()>;
+
+    MetricsServer(uint16_t port, Render render);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    uint16_t port() const { return port_; }
+
+private:
+    void accept_loop();
+    void serve(std::shared_ptr<tcp::socket> socket);
+
+    boost::asio::io_context io_;
+    tcp::acceptor acceptor_;
+    uint16_t port_;
+    Render render_;
+    std::thread thread_;
+};
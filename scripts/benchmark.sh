@@ -1,31 +1,32 @@
 #!/usr/bin/env bash
+# Runs `relay bench` over a range of network sizes and appends one CSV row per
+# run to $output (load it in benchmark-dashboard/bench.html). Extra arguments
+# are passed to every run, e.g. --topology ring --rate 20000 --duration 30.
+# TCP links run with TCP_NODELAY unless the arguments say --tuning nagle.
+# With BASELINE=path/to/base.json each run is also checked for regressions.
 
 # fib=(1 2 3 5 8 13 21 34 55 89 144 233 377 610 987 1597 2584 4181)
 fib=(2 8 13 89 377 610 1597 2584 4181)
 
-output="results.md"
-
-echo >> "$output"
-echo "| N | sent | recv | drop | msg/s | p50(ns) | p95(ns) | p99(ns) |" >> "$output"
-echo "|---|------|------|------|-------|---------|---------|---------|" >> "$output"
+output="${OUTPUT:-results.csv}"
+status=0
 
 for n in "${fib[@]}"; do
-    line=$(build/relay "$n" | grep -E 'sent=')
-    if [[ -z "$line" ]]; then
-        echo "| $n | ERROR | ERROR | ERROR | ERROR | ERROR | ERROR | ERROR |" >> "$output"
-        continue
+    args=(--nodes "$n" --format csv --output "$output" "$@")
+    if [[ -n "$BASELINE" ]]; then
+        args+=(--baseline "$BASELINE")
     fi
 
-    # extract values
-    sent=$(echo "$line" | grep -oE 'sent=[0-9]+' | cut -d= -f2)
-    recv=$(echo "$line" | grep -oE 'recv=[0-9]+' | cut -d= -f2)
-    drop=$(echo "$line" | grep -oE 'drop=[0-9]+' | cut -d= -f2)
-    msg=$(echo "$line" | grep -oE 'msg/s=[0-9. ]+' | cut -d= -f2)
-    p50=$(echo "$line" | grep -oE 'p50\(ns\)=[0-9]+' | cut -d= -f2)
-    p95=$(echo "$line" | grep -oE 'p95\(ns\)=[0-9]+' | cut -d= -f2)
-    p99=$(echo "$line" | grep -oE 'p99\(ns\)=[0-9]+' | cut -d= -f2)
-
-    echo "| $n | $sent | $recv | $drop | $msg | $p50 | $p95 | $p99 |" >> "$output"
+    build/relay bench "${args[@]}" > /dev/null
+    rc=$?
+    if [[ $rc -eq 2 ]]; then
+        echo "N=$n: regression against $BASELINE"
+        status=2
+    elif [[ $rc -ne 0 ]]; then
+        echo "N=$n: ERROR (exit $rc)"
+        status=1
+    fi
 done
 
 echo "Done → $output"
+exit $status
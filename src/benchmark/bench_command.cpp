@@ -0,0 +1,353 @@
+#include "benchmark/bench_command.hpp"
+#include "benchmark/benchmark.hpp"
+#include "benchmark/report.hpp"
+#include "core/io_pool.hpp"
+#include "core/logger.hpp"
+#include "core/node.hpp"
+#include "core/trace.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const std::map<std::string, BenchTransport> transports = {
+    {"tcp", BenchTransport::Tcp},
+    {"memory", BenchTransport::Memory},
+    {"local", BenchTransport::Local},
+    {"shm", BenchTransport::Shm}};
+
+static void print_bench_usage() {
+  std::cerr
+      << "Usage: relay bench [flags]\n"
+      << "  --nodes N               Number of nodes (default 10)\n"
+      << "  --topology SPEC         star, line, ring, grid, regular:K, ws:K:BETA,\n"
+      << "                          ba:M or map:PATH (default star)\n"
+      << "  --routing MODE          flood or learned (default flood)\n"
+      << "  --transport T           tcp (loopback), memory (in-process, no "
+         "sockets),\n"
+      << "                          local (unix sockets) or shm (shared "
+         "memory);\n"
+      << "                          map links written as local:// or shm:// "
+         "keep theirs\n"
+      << "  --pool T|auto|off       Shared io threads, off = one per node "
+         "(default auto)\n"
+      << "  --tuning SPEC           Socket options and io thread placement, "
+         "e.g.\n"
+      << "                          nagle,rcvbuf=N,sndbuf=N,busy_poll=USEC,"
+         "reuseport,\n"
+      << "                          cpu=N|A-B,numa=N (default: TCP_NODELAY, "
+         "kernel defaults\n"
+      << "                          otherwise)\n"
+      << "  --port BASE             First listening port (default 10000)\n"
+      << "  --seed S                Seed of the random topologies (default 1)\n"
+      << "  --rate R                Offered msg/s, 0 saturates (default 5000)\n"
+      << "  --producers P           Load generator threads (default 1)\n"
+      << "  --duration S            Seconds to run, per step with --ramp "
+         "(default 10)\n"
+      << "  --payload N|MIN:MAX     Payload bytes (default 16)\n"
+      << "  --coalesce USEC         Write coalescing window (default 0)\n"
+      << "  --interval S            Latency report every S seconds (default 0)\n"
+      << "  --ramp                  Step the rate up from --rate until p99 or "
+         "delivery fail;\n"
+      << "                          exits with 3 when not even the first step "
+         "holds\n"
+      << "  --format json|csv       Output format (default json)\n"
+      << "  --output PATH           Output file, '-' for stdout (default "
+         "bench.<format>);\n"
+      << "                          CSV rows are appended to an existing file\n"
+      << "  --trace N               Trace one in N messages per hop\n"
+      << "  --trace-out PATH        Chrome trace JSON of the traced messages "
+         "(default trace.json)\n"
+      << "  --baseline PATH         Compare with a previous JSON result\n"
+      << "  --threshold T           Allowed relative regression (default 0.10)\n";
+}
+
+static void print_deltas(const BenchReport &baseline,
+                         const BenchReport &current, double threshold,
+                         bool &regressed) {
+  for (const auto &diff :
+       config_differences(baseline.config, current.config))
+    std::cerr << "warning: config differs, " << diff << "\n";
+  if (baseline.environment.io_backend != current.environment.io_backend)
+    std::cerr << "warning: io backend differs, "
+              << baseline.environment.io_backend << " vs "
+              << current.environment.io_backend << "\n";
+
+  std::cout << std::fixed << std::setprecision(1);
+  regressed = false;
+  for (const auto &d : compare(baseline, current, threshold)) {
+    std::cout << d.metric << ": baseline=" << d.baseline
+              << " current=" << d.current << " change=" << d.change * 100
+              << "%" << (d.regression ? " REGRESSION" : "") << "\n";
+    regressed = regressed || d.regression;
+  }
+}
+
+int run_bench(int argc, char *argv[]) {
+  BenchConfig config;
+  std::string pool = "auto";
+  SocketTuning tuning;
+  std::string format = "json";
+  std::string output;
+  std::string baseline;
+  double threshold = 0.10;
+  uint64_t interval_s = 0;
+  uint32_t trace_one_in = 0;
+  std::string trace_out = "trace.json";
+  bool unsustainable = false; // --ramp found no rate the network could take
+
+  try {
+    for (int i = 0; i < argc; ++i) {
+      std::string flag = argv[i];
+      if (flag == "--help" || flag == "-h") {
+        print_bench_usage();
+        return 0;
+      }
+      if (flag == "--ramp") {
+        config.ramp = true;
+        continue;
+      }
+      if (i + 1 >= argc)
+        throw std::invalid_argument(flag + " needs a value");
+      std::string value = argv[++i];
+
+      if (flag == "--nodes")
+        config.nodes = std::stoul(value);
+      else if (flag == "--topology")
+        config.topology = value;
+      else if (flag == "--routing")
+        config.routing = value;
+      else if (flag == "--transport")
+        config.transport = value;
+      else if (flag == "--pool")
+        pool = value;
+      else if (flag == "--tuning")
+        tuning = SocketTuning::parse(value);
+      else if (flag == "--port")
+        config.base_port = static_cast<uint16_t>(std::stoul(value));
+      else if (flag == "--seed")
+        config.seed = std::stoull(value);
+      else if (flag == "--rate")
+        config.rate = std::stod(value);
+      else if (flag == "--producers")
+        config.producers = std::stoul(value);
+      else if (flag == "--duration")
+        config.duration_s = std::stoull(value);
+      else if (flag == "--payload") {
+        auto colon = value.find(':');
+        config.min_payload = std::stoul(value.substr(0, colon));
+        config.max_payload = colon == std::string::npos
+                                 ? config.min_payload
+                                 : std::stoul(value.substr(colon + 1));
+      } else if (flag == "--coalesce")
+        config.coalesce_us = std::stoull(value);
+      else if (flag == "--interval")
+        interval_s = std::stoull(value);
+      else if (flag == "--format")
+        format = value;
+      else if (flag == "--output")
+        output = value;
+      else if (flag == "--trace")
+        trace_one_in = static_cast<uint32_t>(std::stoul(value));
+      else if (flag == "--trace-out")
+        trace_out = value;
+      else if (flag == "--baseline")
+        baseline = value;
+      else if (flag == "--threshold")
+        threshold = std::stod(value);
+      else
+        throw std::invalid_argument("unknown flag " + flag);
+    }
+
+    if (config.routing != "flood" && config.routing != "learned")
+      throw std::invalid_argument("--routing must be flood or learned");
+    if (!transports.count(config.transport))
+      throw std::invalid_argument("--transport must be tcp, memory, local or shm");
+    if (format != "json" && format != "csv")
+      throw std::invalid_argument("--format must be json or csv");
+
+    if (pool == "auto")
+      config.pool_threads = std::max(1u, std::thread::hardware_concurrency());
+    else if (pool != "off")
+      config.pool_threads = std::stoul(pool);
+    config.tuning = tuning.describe();
+  } catch (const std::exception &e) {
+    std::cerr << "relay bench: " << e.what() << "\n";
+    print_bench_usage();
+    return 1;
+  }
+
+  if (output.empty())
+    output = "bench." + format;
+
+  Topology topology;
+  try {
+    topology = Topology::parse(config.topology, config.nodes, config.seed);
+  } catch (const std::exception &e) {
+    std::cerr << "relay bench: " << e.what() << "\n";
+    return 1;
+  }
+  config.nodes = topology.size;
+
+  BenchReport report;
+  report.config = config;
+  report.environment = BenchEnvironment::capture();
+
+  {
+    // Declared before the nodes so it outlives them
+    std::unique_ptr<IoPool> io_pool;
+    if (config.pool_threads > 0)
+      io_pool = std::make_unique<IoPool>(config.pool_threads, tuning);
+
+    // Only TCP links need ports
+    BenchTransport transport = transports.at(config.transport);
+    auto nodes = Benchmark::generate_nodes(config.nodes, config.base_port,
+                                           io_pool.get(),
+                                           transport == BenchTransport::Tcp,
+                                           tuning);
+
+    LoadConfig load;
+    load.producers = config.producers;
+    load.rate = config.rate;
+    load.min_payload = config.min_payload;
+    load.max_payload = config.max_payload;
+
+    Benchmark bench(nodes, config.duration_s, load);
+    bench.set_topology(topology);
+    bench.set_transport(transport);
+    bench.set_routing_mode(config.routing == "learned" ? RoutingMode::Learned
+                                                       : RoutingMode::Flood);
+    ConnectionOptions options;
+    options.coalesce_window = std::chrono::microseconds(config.coalesce_us);
+    bench.set_connection_options(options);
+    bench.set_report_interval(std::chrono::seconds(interval_s));
+    Tracer::instance().set_sample_rate(trace_one_in);
+
+    if (config.ramp) {
+      Benchmark::RampConfig ramp;
+      if (config.rate > 0)
+        ramp.start_rate = config.rate;
+      ramp.step = std::chrono::seconds(config.duration_s);
+      report.ramp = bench.ramp(ramp);
+
+      // The headline result is the last sustainable step. Without one it
+      // stays empty: a failed step is no capacity figure.
+      unsustainable = true;
+      for (const auto &step : report.ramp)
+        if (step.sustainable) {
+          report.result = step.result;
+          unsustainable = false;
+        }
+    } else {
+      bench.start();
+      report.result = bench.wait_and_collect();
+      report.intervals = bench.intervals();
+    }
+
+    // Stop the io threads before the benchmark their handlers point into
+    nodes.clear();
+  }
+
+  if (trace_one_in) {
+    Tracer::instance().set_sample_rate(0);
+    std::ofstream trace_file(trace_out);
+    auto events = Tracer::instance().snapshot();
+    Tracer::write_chrome_json(trace_file, events);
+    std::cerr << "relay bench: " << events.size() << " trace events -> "
+              << trace_out << "\n";
+  }
+
+  std::ofstream file;
+  std::ostream *out = &std::cout;
+  if (output != "-") {
+    bool append = false;
+    if (format == "csv") {
+      std::ifstream existing(output);
+      append = existing.good() &&
+               existing.peek() != std::ifstream::traits_type::eof();
+    }
+    file.open(output, append ? std::ios::app : std::ios::trunc);
+    if (!file) {
+      std::cerr << "relay bench: cannot write " << output << "\n";
+      return 1;
+    }
+    out = &file;
+    if (format == "csv" && !append)
+      write_csv_header(file);
+  } else if (format == "csv") {
+    write_csv_header(std::cout);
+  }
+
+  if (format == "json")
+    write_json(*out, report);
+  else
+    write_csv_row(*out, report);
+  out->flush();
+
+  Logger::instance().flush();
+  if (unsustainable) {
+    std::cerr << "relay bench: no ramp step was sustainable";
+    if (!report.ramp.empty())
+      std::cerr << ", not even " << report.ramp.front().target_rate << " msg/s";
+    std::cerr
+              << (output != "-" ? "; steps -> " + output : "") << "\n";
+    return 3;
+  }
+  std::cerr << "relay bench: delivered/s=" << report.result.delivered_per_sec
+            << " p50(ns)=" << report.result.p50_ns
+            << " p99(ns)=" << report.result.p99_ns;
+  if (report.result.undelivered)
+    std::cerr << " undelivered=" << report.result.undelivered;
+  std::cerr << (output != "-" ? " -> " + output : "") << "\n";
+
+  if (baseline.empty())
+    return 0;
+
+  try {
+    bool regressed;
+    print_deltas(read_json(baseline), report, threshold, regressed);
+    return regressed ? 2 : 0;
+  } catch (const std::exception &e) {
+    std::cerr << "relay bench: " << e.what() << "\n";
+    return 1;
+  }
+}
+
+int run_compare(int argc, char *argv[]) {
+  double threshold = 0.10;
+  std::vector<std::string> files;
+
+  for (int i = 0; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--threshold" && i + 1 < argc)
+      threshold = std::atof(argv[++i]);
+    else
+      files.push_back(arg);
+  }
+
+  if (files.size() != 2) {
+    std::cerr << "Usage: relay compare <baseline.json> <run.json> "
+                 "[--threshold T]\n"
+              << "Exits with 2 when throughput drops or p50/p99/p99.9 grow "
+                 "by more than T (default 0.10)\n";
+    return 1;
+  }
+
+  try {
+    bool regressed;
+    print_deltas(read_json(files[0]), read_json(files[1]), threshold,
+                 regressed);
+    return regressed ? 2 : 0;
+  } catch (const std::exception &e) {
+    std::cerr << "relay compare: " << e.what() << "\n";
+    return 1;
+  }
+}
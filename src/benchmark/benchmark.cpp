@@ -1,19 +1,22 @@
 #include "benchmark/benchmark.hpp"
+#include "benchmark/alloc_counter.hpp"
+#include "core/logger.hpp"
 #include "core/node.hpp"
 
 #include <algorithm>
 #include <thread>
 #include <random>
 #include <chrono>
-#include <iostream>
 #include <cstring>
-
-#ifndef PORT_BASE
-#define PORT_BASE 10000
-#endif
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
 
 using clock_t_ = std::chrono::steady_clock;
 
+// How long the end of a window waits for messages still in flight
+static constexpr auto kDrainTimeout = std::chrono::seconds(2);
+
 static inline uint64_t now_ns() {
   return std::chrono::duration_cast<std::chrono::nanoseconds>(
              clock_t_::now().time_since_epoch())
@@ -24,15 +27,22 @@ static inline uint64_t now_ns() {
    STATIC NODE FACTORY
    ============================ */
 std::vector<std::unique_ptr<Node>>
-Benchmark::generate_nodes(std::size_t count, uint16_t base_port) {
+Benchmark::generate_nodes(std::size_t count, uint16_t base_port,
+                          IoPool *pool, bool listen,
+                          const SocketTuning &tuning) {
   std::vector<std::unique_ptr<Node>> nodes;
   nodes.reserve(count);
 
   for (std::size_t i = 0; i < count; ++i) {
-    nodes.emplace_back(std::make_unique<Node>(
-        static_cast<uint64_t>(i), static_cast<uint16_t>(base_port + i))
-
-    );
+    auto id = static_cast<uint64_t>(i);
+    std::optional<uint16_t> port;
+    if (listen)
+      port = static_cast<uint16_t>(base_port + i);
+
+    if (pool)
+      nodes.emplace_back(std::make_unique<Node>(id, port, *pool, tuning));
+    else
+      nodes.emplace_back(std::make_unique<Node>(id, port, tuning));
   }
 
   return nodes;
@@ -43,61 +53,158 @@ Benchmark::generate_nodes(std::size_t count, uint16_t base_port) {
    ============================ */
 
 Benchmark::Benchmark(std::vector<std::unique_ptr<Node>> &nodes,
-                     uint64_t duration_seconds)
-    : nodes_(nodes), duration_s_(duration_seconds) {}
+                     uint64_t duration_seconds, const LoadConfig &load)
+    : nodes_(nodes), duration_s_(duration_seconds), load_config_(load) {
+  // Every payload carries seq and timestamp
+  load_config_.min_payload =
+      std::max(load_config_.min_payload, sizeof(uint64_t) * 2);
+  load_config_.max_payload =
+      std::max(load_config_.max_payload, load_config_.min_payload);
+  load_config_.producers = std::max<std::size_t>(load_config_.producers, 1);
+  producers_.resize(load_config_.producers);
+}
 
-void Benchmark::start() {
-  run_nodes();
-  connect_server_client();
+Benchmark::~Benchmark() {
+  // Producers and the reporter call back into this object
+  if (load_)
+    load_->stop();
+  running_.store(false, std::memory_order_release);
+  reporter_cv_.notify_all();
+  if (reporter_.joinable())
+    reporter_.join();
+}
 
-  std::cout << "Starting The Benchmark" << std::endl;
-  running_.store(true, std::memory_order_release);
-  start_tp_ = clock_t_::now();
+void Benchmark::set_routing_mode(RoutingMode mode) {
+  for (auto &n : nodes_)
+    n->set_routing_mode(mode);
+}
+
+void Benchmark::set_connection_options(const ConnectionOptions &options) {
+  for (auto &n : nodes_)
+    n->set_connection_options(options);
+}
+
+void Benchmark::prepare_() {
+  if (nodes_.size() < 2)
+    throw std::invalid_argument("The benchmark needs at least two nodes");
+
+  if (!topology_)
+    topology_ = Topology::star(nodes_.size(), dst_index_);
+  if (topology_->size != nodes_.size())
+    throw std::invalid_argument("The topology size does not match the nodes");
+
+  hops_ = topology_->hops_from(dst_index_);
+  int max_hops = *std::max_element(hops_.begin(), hops_.end());
+  hop_latencies_.clear();
+  for (int h = 0; h <= max_hops; ++h)
+    hop_latencies_.push_back(std::make_unique<PerThreadHistograms>());
+
+  // Flooded copies may take a longer path first and mark the shorter one
+  // as seen, so leave twice the distance to the destination
+  int ttl = std::clamp(2 * max_hops, int{kDefaultTtl}, int{UINT16_MAX});
+  for (auto &n : nodes_)
+    n->set_ttl(static_cast<uint16_t>(ttl));
+
+  run_nodes();
+  connect_topology(*topology_);
 
   for (auto &n : nodes_) {
-    n->set_receive_handler(
-        [this](uint64_t node_id, uint64_t from_id, const std::string &msg) {
-          on_receive(node_id, from_id, msg);
-        });
+    n->set_delivery_handler([this](uint64_t node_id, const Delivery &d) {
+      on_receive(node_id, d.header.src_node_id, d.payload);
+    });
   }
 
-  std::thread([this] {
-    constexpr auto interval = std::chrono::microseconds(200); // ~5k msg/s
+  // Give the connections a moment to come up before offering load
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  // Producers start on different senders so they don't all hit one node
+  for (std::size_t p = 0; p < producers_.size(); ++p)
+    producers_[p].next_sender = p;
+}
 
-    auto next = clock_t_::now();
+void Benchmark::begin_window_() {
+  sent_.store(0);
+  received_.store(0);
+  dropped_.store(0);
+  window_start_ = latencies_.snapshot();
+  hop_window_start_.clear();
+  for (auto &h : hop_latencies_)
+    hop_window_start_.push_back(h->snapshot());
 
-    while (running_.load(std::memory_order_acquire)) {
-      send_tick();
-      next += interval;
-      std::this_thread::sleep_until(next);
-    }
-  }).detach();
+  start_node_drops_ = 0;
+  for (auto &n : nodes_)
+    start_node_drops_ += n->dropped() + n->ttl_expired();
+
+  start_tp_ = clock_t_::now();
+  start_allocations_ = heap_allocations();
+  running_.store(true, std::memory_order_release);
 }
 
-void Benchmark::send_tick() {
-  static uint64_t seq = 0;
+void Benchmark::start() {
+  prepare_();
 
-  uint64_t ts = now_ns();
-  std::string payload;
-  payload.resize(sizeof(uint64_t) * 2);
+  LOG_INFO("Starting The Benchmark");
+  begin_window_();
 
-  std::memcpy(payload.data(), &seq, sizeof(uint64_t));
-  std::memcpy(payload.data() + sizeof(uint64_t), &ts, sizeof(uint64_t));
+  load_ = std::make_unique<LoadGenerator>(
+      load_config_, [this](std::size_t producer, uint64_t seq,
+                           uint64_t intended_ns, std::size_t size) {
+        send_one_(producer, seq, intended_ns, size);
+      });
+  load_->start();
 
-  static std::size_t index = 1;
-  uint64_t dst = 0;
+  intervals_.clear();
+  if (report_interval_.count() > 0)
+    reporter_ = std::thread([this] { report_loop_(); });
+}
 
-  if (!index)
-    index = (index + 1) % nodes_.size();
-  nodes_[index]->send(dst, payload);
+void Benchmark::report_loop_() {
+  HistogramSnapshot last = window_start_;
+  auto next = start_tp_ + report_interval_;
+
+  std::unique_lock lk(reporter_mtx_);
+  while (!reporter_cv_.wait_until(
+      lk, next, [this] { return !running_.load(std::memory_order_acquire); })) {
+    HistogramSnapshot now = latencies_.snapshot();
+    HistogramSnapshot delta = now.since(last);
+    last = now;
+
+    Interval iv{std::chrono::duration<double>(next - start_tp_).count(),
+                delta.count(), delta.percentile(0.50), delta.percentile(0.99),
+                delta.percentile(0.999)};
+    intervals_.push_back(iv);
+
+    LOG_INFO("interval t=" << iv.end_s << "s recv=" << iv.received
+                           << " p50(ns)=" << iv.p50_ns << " p99(ns)=" << iv.p99_ns
+                           << " p99.9(ns)=" << iv.p999_ns);
+    next += report_interval_;
+  }
+}
 
+void Benchmark::send_one_(std::size_t producer, uint64_t seq,
+                          uint64_t intended_ns, std::size_t payload_size) {
+  auto &p = producers_[producer];
+
+  // Stamped with the intended send time, see LoadGenerator
+  p.payload.resize(payload_size);
+  std::memcpy(p.payload.data(), &seq, sizeof(uint64_t));
+  std::memcpy(p.payload.data() + sizeof(uint64_t), &intended_ns,
+              sizeof(uint64_t));
+
+  // Round-robin over every node except the destination, each producer
+  // striding by the producer count
+  std::size_t senders = nodes_.size() - 1;
+  std::size_t index = p.next_sender % senders;
+  if (index >= dst_index_)
+    ++index;
+  p.next_sender += producers_.size();
+
+  nodes_[index]->send(nodes_[dst_index_]->get_id(), p.payload);
   ++sent_;
-  ++seq;
-  index = (index + 1) % nodes_.size();
 }
 
 void Benchmark::on_receive(uint64_t node_id, uint64_t from_id,
-                           const std::string &msg) {
+                           Span<const uint8_t> msg) {
   if (msg.size() < sizeof(uint64_t) * 2) {
     ++dropped_;
     return;
@@ -111,45 +218,120 @@ void Benchmark::on_receive(uint64_t node_id, uint64_t from_id,
 
   uint64_t latency = now_ns() - ts;
 
-  {
-    std::lock_guard lk(latency_mtx_);
-    latencies_ns_.push_back(latency);
-  }
+  latencies_.local().record(latency);
+  if (from_id < hops_.size() && hops_[from_id] >= 0)
+    hop_latencies_[hops_[from_id]]->local().record(latency);
 
   ++received_;
 
-  std::cout << "[NODE " << node_id << "] "
-            << "from=" << from_id << " seq=" << seq
-            << " latency(ns)=" << latency << std::endl;
+  LOG_TRACE("[NODE " << node_id << "] from=" << from_id << " seq=" << seq
+                     << " latency(ns)=" << latency);
 }
 
 Benchmark::Result Benchmark::wait_and_collect() {
   std::this_thread::sleep_for(std::chrono::seconds(duration_s_));
 
-  running_.store(false, std::memory_order_release);
+  end_window_();
+  Result r = collect_();
 
-  auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(
-                     clock_t_::now() - start_tp_)
-                     .count();
+  reporter_cv_.notify_all();
+  if (reporter_.joinable())
+    reporter_.join();
+  return r;
+}
+
+std::vector<Benchmark::RampStep> Benchmark::ramp(const RampConfig &config) {
+  prepare_();
 
-  std::vector<uint64_t> lats;
-  {
-    std::lock_guard lk(latency_mtx_);
-    lats = latencies_ns_;
+  std::vector<RampStep> steps;
+  for (double rate = config.start_rate; rate <= config.max_rate;
+       rate *= config.growth) {
+    LoadConfig step_load = load_config_;
+    step_load.rate = rate;
+
+    begin_window_();
+    load_ = std::make_unique<LoadGenerator>(
+        step_load, [this](std::size_t producer, uint64_t seq,
+                          uint64_t intended_ns, std::size_t size) {
+          send_one_(producer, seq, intended_ns, size);
+        });
+    load_->start();
+    std::this_thread::sleep_for(config.step);
+    end_window_();
+
+    Result r = collect_();
+    double delivery = r.sent ? static_cast<double>(r.received) / r.sent : 0;
+    bool ok = r.p99_ns <= config.max_p99_ns && delivery >= config.min_delivery;
+
+    LOG_INFO("ramp rate=" << rate << " delivered/s=" << r.delivered_per_sec
+                          << " p99(ns)=" << r.p99_ns << " delivery=" << delivery
+                          << (ok ? "" : " <- unsustainable"));
+
+    steps.push_back({rate, r, ok});
+    if (!ok || config.growth <= 1.0)
+      break;
   }
 
-  std::sort(lats.begin(), lats.end());
+  return steps;
+}
 
-  auto pct = [&](double p) -> uint64_t {
-    if (lats.empty())
-      return 0;
-    std::size_t idx = static_cast<std::size_t>(p * lats.size());
-    return lats[std::min(idx, lats.size() - 1)];
-  };
+void Benchmark::end_window_() {
+  load_->stop();
+  end_tp_ = clock_t_::now();
 
-  return {
-      sent_.load(), received_.load(), dropped_.load(), sent_.load() / elapsed,
-      pct(0.50),    pct(0.95),        pct(0.99)};
+  // Let the tail arrive before judging the window: until every message is
+  // received or dropped, or the timeout leaves the rest undelivered
+  auto deadline = end_tp_ + kDrainTimeout;
+  while (received_.load() + window_drops_() < sent_.load() &&
+         clock_t_::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+// Malformed deliveries, frames the nodes dropped on full or dead queues and
+// messages whose TTL ran out, since begin_window_()
+uint64_t Benchmark::window_drops_() const {
+  uint64_t dropped = dropped_.load() - start_node_drops_;
+  for (auto &n : nodes_)
+    dropped += n->dropped() + n->ttl_expired();
+  return dropped;
+}
+
+Benchmark::Result Benchmark::collect_() {
+  running_.store(false, std::memory_order_release);
+  uint64_t allocations = heap_allocations() - start_allocations_;
+
+  // Rates cover the time load was offered, not the drain
+  auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(
+                     end_tp_ - start_tp_)
+                     .count();
+
+  HistogramSnapshot lats = latencies_.snapshot().since(window_start_);
+
+  Result r{};
+  r.sent = sent_.load();
+  r.received = received_.load();
+  r.dropped = window_drops_();
+  // Flooding can drop surplus copies of a message that still arrived
+  r.undelivered = r.sent - std::min(r.sent, r.received + r.dropped);
+  r.msg_per_sec = r.sent / elapsed;
+  r.p50_ns = lats.percentile(0.50);
+  r.p90_ns = lats.percentile(0.90);
+  r.p95_ns = lats.percentile(0.95);
+  r.p99_ns = lats.percentile(0.99);
+  r.p999_ns = lats.percentile(0.999);
+  r.max_ns = lats.max();
+  r.allocations = allocations;
+  r.delivered_per_sec = r.received / elapsed;
+
+  for (std::size_t h = 0; h < hop_latencies_.size(); ++h) {
+    HistogramSnapshot snap =
+        hop_latencies_[h]->snapshot().since(hop_window_start_[h]);
+    if (snap.count() == 0)
+      continue;
+    r.by_hops.push_back({static_cast<int>(h), snap.count(),
+                         snap.percentile(0.50), snap.percentile(0.99)});
+  }
+  return r;
 }
 
 void Benchmark::connect_server_client(int server_index) {
@@ -157,15 +339,46 @@ void Benchmark::connect_server_client(int server_index) {
   if (server_index >= nodes_.size())
     throw std::overflow_error("The Server index has a overflow position");
 
-  tcp::endpoint ep(boost::asio::ip::make_address("127.0.0.1"),
-                   PORT_BASE + server_index);
+  connect_topology(Topology::star(nodes_.size(), server_index));
+}
 
-  for (size_t i = 0; i < nodes_.size(); i++) {
-    if (i == server_index)
-      continue;
+void Benchmark::connect_topology(const Topology &topology) {
+  auto loopback = boost::asio::ip::make_address("127.0.0.1");
+
+  for (std::size_t i = 0; i < topology.edges.size(); ++i) {
+    auto [from, to] = topology.edges[i];
+    BenchTransport transport = transport_;
+    if (topology.link(i) == EdgeLink::Local)
+      transport = BenchTransport::Local;
+    else if (topology.link(i) == EdgeLink::Shm)
+      transport = BenchTransport::Shm;
+
+    switch (transport) {
+    case BenchTransport::Memory:
+      nodes_[from]->connect(*nodes_[to]);
+      break;
+    case BenchTransport::Local:
+      nodes_[from]->connect(LocalEndpoint{local_path_(to), LocalLink::Stream});
+      break;
+    case BenchTransport::Shm:
+      nodes_[from]->connect(LocalEndpoint{local_path_(to), LocalLink::Shm});
+      break;
+    case BenchTransport::Tcp:
+      nodes_[from]->connect(tcp::endpoint(loopback, nodes_[to]->get_port()));
+      break;
+    }
+  }
+}
 
-    nodes_[i]->connect(ep);
+std::string Benchmark::local_path_(std::size_t index) {
+  Node &node = *nodes_[index];
+  if (node.local_path().empty()) {
+    auto path = std::filesystem::temp_directory_path() /
+                ("relay-bench-" + std::to_string(::getpid()) + "-" +
+                 std::to_string(node.get_id()) + ".sock");
+    node.listen_local(path.string());
   }
+  return node.local_path();
 }
 
 void Benchmark::run_nodes() {
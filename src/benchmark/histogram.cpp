@@ -0,0 +1,105 @@
+#include "benchmark/histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+// Layout: [0, 128) exact, then for every exponent e >= 1 the range
+// [64 << e, 128 << e) split into 64 sub-buckets of width 1 << e.
+std::size_t LatencyHistogram::index_of(uint64_t value) {
+  if (value < 2 * sub_buckets)
+    return static_cast<std::size_t>(value);
+
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - 6;
+  std::size_t sub = static_cast<std::size_t>(value >> shift) - sub_buckets;
+  std::size_t index = 2 * sub_buckets + (shift - 1) * sub_buckets + sub;
+  return std::min(index, bucket_count - 1);
+}
+
+uint64_t LatencyHistogram::value_at(std::size_t index) {
+  if (index < 2 * sub_buckets)
+    return index;
+
+  std::size_t shift = (index - 2 * sub_buckets) / sub_buckets + 1;
+  std::size_t sub = (index - 2 * sub_buckets) % sub_buckets + sub_buckets;
+  // Middle of the sub-bucket
+  return (static_cast<uint64_t>(sub) << shift) + (uint64_t{1} << shift) / 2;
+}
+
+void HistogramSnapshot::add(const LatencyHistogram &h) {
+  for (std::size_t i = 0; i < counts_.size(); ++i) {
+    uint64_t c = h.counts_[i].load(std::memory_order_relaxed);
+    counts_[i] += c;
+    total_ += c;
+  }
+  max_ = std::max(max_, h.max_.load(std::memory_order_relaxed));
+}
+
+HistogramSnapshot
+HistogramSnapshot::since(const HistogramSnapshot &earlier) const {
+  HistogramSnapshot delta;
+  for (std::size_t i = 0; i < counts_.size(); ++i) {
+    // Histograms only grow, but stay safe against torn snapshots
+    uint64_t c = counts_[i] > earlier.counts_[i]
+                     ? counts_[i] - earlier.counts_[i]
+                     : 0;
+    delta.counts_[i] = c;
+    delta.total_ += c;
+    if (c)
+      delta.max_ = std::min(LatencyHistogram::value_at(i), max_);
+  }
+  return delta;
+}
+
+uint64_t HistogramSnapshot::percentile(double p) const {
+  if (total_ == 0)
+    return 0;
+
+  auto rank = static_cast<uint64_t>(std::ceil(p * total_));
+  rank = std::max<uint64_t>(rank, 1);
+
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank)
+      return std::min(LatencyHistogram::value_at(i), max_);
+  }
+  return max_;
+}
+
+static std::atomic<uint64_t> g_next_set_id{1};
+
+PerThreadHistograms::PerThreadHistograms()
+    : id_(g_next_set_id.fetch_add(1, std::memory_order_relaxed)) {}
+
+LatencyHistogram &PerThreadHistograms::local() {
+  // Cached per thread and per set, keyed by a never reused id rather than
+  // the address. Threads record into several sets in turn (total and
+  // per-hop latency), so the last set used is checked before the map.
+  thread_local uint64_t last_owner = 0;
+  thread_local LatencyHistogram *last = nullptr;
+  thread_local std::unordered_map<uint64_t, LatencyHistogram *> owned;
+
+  if (last_owner == id_)
+    return *last;
+
+  LatencyHistogram *&histogram = owned[id_];
+  if (!histogram) {
+    auto h = std::make_unique<LatencyHistogram>();
+    std::lock_guard lk(mtx_);
+    histogram = h.get();
+    histograms_.push_back(std::move(h));
+  }
+  last_owner = id_;
+  last = histogram;
+  return *histogram;
+}
+
+HistogramSnapshot PerThreadHistograms::snapshot() const {
+  HistogramSnapshot snap;
+  std::lock_guard lk(mtx_);
+  for (auto &h : histograms_)
+    snap.add(*h);
+  return snap;
+}
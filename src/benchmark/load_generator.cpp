@@ -0,0 +1,66 @@
+#include "benchmark/load_generator.hpp"
+
+#include <algorithm>
+#include <random>
+
+using clock_t_ = std::chrono::steady_clock;
+
+LoadGenerator::LoadGenerator(const LoadConfig &config, SendFn send)
+    : config_(config), send_(std::move(send)) {
+  config_.producers = std::max<std::size_t>(config_.producers, 1);
+  config_.max_payload = std::max(config_.max_payload, config_.min_payload);
+}
+
+LoadGenerator::~LoadGenerator() { stop(); }
+
+void LoadGenerator::start() {
+  running_.store(true, std::memory_order_release);
+  for (std::size_t p = 0; p < config_.producers; ++p)
+    threads_.emplace_back([this, p] { produce_(p); });
+}
+
+void LoadGenerator::stop() {
+  running_.store(false, std::memory_order_release);
+  for (auto &t : threads_)
+    if (t.joinable())
+      t.join();
+  threads_.clear();
+}
+
+void LoadGenerator::produce_(std::size_t producer) {
+  std::mt19937_64 rng(0x5eed + producer);
+  std::uniform_int_distribution<std::size_t> size_dist(config_.min_payload,
+                                                       config_.max_payload);
+
+  const bool saturate = config_.rate <= 0;
+  const auto interval = std::chrono::duration_cast<clock_t_::duration>(
+      std::chrono::duration<double>(
+          saturate ? 0.0 : config_.producers / config_.rate));
+
+  // Producers are staggered so their sends interleave evenly
+  auto next = clock_t_::now() + interval * producer / config_.producers;
+
+  // The top bits keep seq unique across producers
+  uint64_t seq = static_cast<uint64_t>(producer) << 48;
+
+  while (running_.load(std::memory_order_acquire)) {
+    if (!saturate) {
+      // Sleep most of the way, then yield-spin for sub-timer-slack precision
+      auto now = clock_t_::now();
+      if (next - now > std::chrono::microseconds(100))
+        std::this_thread::sleep_until(next - std::chrono::microseconds(50));
+      while (clock_t_::now() < next)
+        std::this_thread::yield();
+    } else {
+      next = clock_t_::now();
+    }
+
+    uint64_t intended = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            next.time_since_epoch())
+                            .count();
+    send_(producer, seq++, intended, size_dist(rng));
+    scheduled_.fetch_add(1, std::memory_order_relaxed);
+
+    next += interval;
+  }
+}
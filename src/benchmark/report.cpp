@@ -0,0 +1,337 @@
+#include "benchmark/report.hpp"
+#include "core/transport.hpp"
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/version.hpp>
+
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/utsname.h>
+#include <unistd.h>
+
+namespace pt = boost::property_tree;
+
+// Set by CMake from `git rev-parse` at configure time
+#ifndef RELAY_GIT_REV
+#define RELAY_GIT_REV "unknown"
+#endif
+
+static std::string read_cpu_model() {
+  std::ifstream in("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind("model name", 0) != 0)
+      continue;
+    auto colon = line.find(':');
+    if (colon != std::string::npos && colon + 2 <= line.size())
+      return line.substr(colon + 2);
+  }
+  return "unknown";
+}
+
+BenchEnvironment BenchEnvironment::capture() {
+  BenchEnvironment env;
+
+  std::time_t now = std::time(nullptr);
+  char buf[32];
+  std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+  env.timestamp = buf;
+
+  char host[256] = {};
+  if (gethostname(host, sizeof(host) - 1) == 0)
+    env.hostname = host;
+
+  env.cpu_model = read_cpu_model();
+  env.cores = std::thread::hardware_concurrency();
+
+  utsname uts{};
+  if (uname(&uts) == 0)
+    env.kernel = std::string(uts.sysname) + " " + uts.release + " " +
+                 uts.machine;
+
+#if defined(__clang__)
+  env.compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+  env.compiler = "gcc " __VERSION__;
+#else
+  env.compiler = "unknown";
+#endif
+
+  env.boost = std::to_string(BOOST_VERSION / 100000) + "." +
+              std::to_string(BOOST_VERSION / 100 % 1000) + "." +
+              std::to_string(BOOST_VERSION % 100);
+  env.git_rev = RELAY_GIT_REV;
+  env.io_backend = tcp_backend();
+  return env;
+}
+
+/* ============================
+   JSON / CSV WRITERS
+   ============================ */
+
+static std::string quoted(const std::string &s) {
+  std::string out = "\"";
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        continue;
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+static void write_result(std::ostream &out, const Benchmark::Result &r,
+                         const char *indent) {
+  out << "{\n"
+      << indent << "  \"sent\": " << r.sent << ",\n"
+      << indent << "  \"received\": " << r.received << ",\n"
+      << indent << "  \"dropped\": " << r.dropped << ",\n"
+      << indent << "  \"undelivered\": " << r.undelivered << ",\n"
+      << indent << "  \"msg_per_sec\": " << r.msg_per_sec << ",\n"
+      << indent << "  \"delivered_per_sec\": " << r.delivered_per_sec << ",\n"
+      << indent << "  \"p50_ns\": " << r.p50_ns << ",\n"
+      << indent << "  \"p90_ns\": " << r.p90_ns << ",\n"
+      << indent << "  \"p95_ns\": " << r.p95_ns << ",\n"
+      << indent << "  \"p99_ns\": " << r.p99_ns << ",\n"
+      << indent << "  \"p999_ns\": " << r.p999_ns << ",\n"
+      << indent << "  \"max_ns\": " << r.max_ns << ",\n"
+      << indent << "  \"allocations\": " << r.allocations << ",\n"
+      << indent << "  \"by_hops\": [";
+  for (std::size_t i = 0; i < r.by_hops.size(); ++i) {
+    const auto &h = r.by_hops[i];
+    out << (i ? ", " : "") << "{\"hops\": " << h.hops
+        << ", \"received\": " << h.received << ", \"p50_ns\": " << h.p50_ns
+        << ", \"p99_ns\": " << h.p99_ns << "}";
+  }
+  out << "]\n" << indent << "}";
+}
+
+void write_json(std::ostream &out, const BenchReport &report) {
+  const auto &c = report.config;
+  const auto &e = report.environment;
+  auto precision = out.precision(12);
+
+  out << "{\n"
+      << "  \"config\": {\n"
+      << "    \"nodes\": " << c.nodes << ",\n"
+      << "    \"topology\": " << quoted(c.topology) << ",\n"
+      << "    \"routing\": " << quoted(c.routing) << ",\n"
+      << "    \"transport\": " << quoted(c.transport) << ",\n"
+      << "    \"tuning\": " << quoted(c.tuning) << ",\n"
+      << "    \"pool_threads\": " << c.pool_threads << ",\n"
+      << "    \"base_port\": " << c.base_port << ",\n"
+      << "    \"seed\": " << c.seed << ",\n"
+      << "    \"rate\": " << c.rate << ",\n"
+      << "    \"producers\": " << c.producers << ",\n"
+      << "    \"duration_s\": " << c.duration_s << ",\n"
+      << "    \"min_payload\": " << c.min_payload << ",\n"
+      << "    \"max_payload\": " << c.max_payload << ",\n"
+      << "    \"coalesce_us\": " << c.coalesce_us << ",\n"
+      << "    \"ramp\": " << (c.ramp ? "true" : "false") << "\n"
+      << "  },\n"
+      << "  \"environment\": {\n"
+      << "    \"timestamp\": " << quoted(e.timestamp) << ",\n"
+      << "    \"hostname\": " << quoted(e.hostname) << ",\n"
+      << "    \"cpu_model\": " << quoted(e.cpu_model) << ",\n"
+      << "    \"cores\": " << e.cores << ",\n"
+      << "    \"kernel\": " << quoted(e.kernel) << ",\n"
+      << "    \"compiler\": " << quoted(e.compiler) << ",\n"
+      << "    \"boost\": " << quoted(e.boost) << ",\n"
+      << "    \"git_rev\": " << quoted(e.git_rev) << ",\n"
+      << "    \"io_backend\": " << quoted(e.io_backend) << "\n"
+      << "  },\n"
+      << "  \"result\": ";
+  write_result(out, report.result, "  ");
+
+  out << ",\n  \"intervals\": [";
+  for (std::size_t i = 0; i < report.intervals.size(); ++i) {
+    const auto &iv = report.intervals[i];
+    out << (i ? "," : "") << "\n    {\"end_s\": " << iv.end_s
+        << ", \"received\": " << iv.received << ", \"p50_ns\": " << iv.p50_ns
+        << ", \"p99_ns\": " << iv.p99_ns << ", \"p999_ns\": " << iv.p999_ns
+        << "}";
+  }
+  out << (report.intervals.empty() ? "]" : "\n  ]");
+
+  out << ",\n  \"ramp\": [";
+  for (std::size_t i = 0; i < report.ramp.size(); ++i) {
+    const auto &step = report.ramp[i];
+    out << (i ? "," : "") << "\n    {\"target_rate\": " << step.target_rate
+        << ", \"sustainable\": " << (step.sustainable ? "true" : "false")
+        << ", \"result\": ";
+    write_result(out, step.result, "    ");
+    out << "}";
+  }
+  out << (report.ramp.empty() ? "]" : "\n  ]") << "\n}\n";
+
+  out.precision(precision);
+}
+
+static std::string csv_field(const std::string &s) {
+  if (s.find_first_of(",\"\n") == std::string::npos)
+    return s;
+  std::string out = "\"";
+  for (char c : s)
+    out += c == '"' ? std::string("\"\"") : std::string(1, c);
+  return out + "\"";
+}
+
+void write_csv_header(std::ostream &out) {
+  out << "timestamp,hostname,git_rev,nodes,topology,routing,transport,"
+         "pool_threads,rate,producers,duration_s,min_payload,max_payload,coalesce_us,"
+         "ramp,sent,received,dropped,msg_per_sec,delivered_per_sec,p50_ns,"
+         "p90_ns,p95_ns,p99_ns,p999_ns,max_ns,allocations,io_backend,tuning,"
+         "undelivered\n";
+}
+
+void write_csv_row(std::ostream &out, const BenchReport &report) {
+  const auto &c = report.config;
+  const auto &e = report.environment;
+  const auto &r = report.result;
+  auto precision = out.precision(12);
+
+  out << e.timestamp << ',' << csv_field(e.hostname) << ',' << e.git_rev
+      << ',' << c.nodes << ',' << csv_field(c.topology) << ',' << c.routing
+      << ',' << c.transport << ',' << c.pool_threads << ',' << c.rate << ',' << c.producers << ','
+      << c.duration_s << ',' << c.min_payload << ',' << c.max_payload << ','
+      << c.coalesce_us << ',' << (c.ramp ? 1 : 0) << ',' << r.sent << ','
+      << r.received << ',' << r.dropped << ',' << r.msg_per_sec << ','
+      << r.delivered_per_sec << ',' << r.p50_ns << ',' << r.p90_ns << ','
+      << r.p95_ns << ',' << r.p99_ns << ',' << r.p999_ns << ',' << r.max_ns
+      << ',' << r.allocations << ',' << e.io_backend << ','
+      << csv_field(c.tuning) << ',' << r.undelivered << '\n';
+
+  out.precision(precision);
+}
+
+/* ============================
+   BASELINE COMPARISON
+   ============================ */
+
+BenchReport read_json(const std::string &path) {
+  pt::ptree tree;
+  try {
+    pt::read_json(path, tree);
+  } catch (const pt::json_parser_error &e) {
+    throw std::runtime_error(e.what());
+  }
+
+  BenchReport report;
+  auto &c = report.config;
+  c.nodes = tree.get("config.nodes", c.nodes);
+  c.topology = tree.get("config.topology", c.topology);
+  c.routing = tree.get("config.routing", c.routing);
+  c.transport = tree.get("config.transport", c.transport);
+  c.tuning = tree.get("config.tuning", c.tuning);
+  c.pool_threads = tree.get("config.pool_threads", c.pool_threads);
+  c.base_port = tree.get("config.base_port", c.base_port);
+  c.seed = tree.get("config.seed", c.seed);
+  c.rate = tree.get("config.rate", c.rate);
+  c.producers = tree.get("config.producers", c.producers);
+  c.duration_s = tree.get("config.duration_s", c.duration_s);
+  c.min_payload = tree.get("config.min_payload", c.min_payload);
+  c.max_payload = tree.get("config.max_payload", c.max_payload);
+  c.coalesce_us = tree.get("config.coalesce_us", c.coalesce_us);
+  c.ramp = tree.get("config.ramp", c.ramp);
+
+  auto &e = report.environment;
+  e.timestamp = tree.get("environment.timestamp", "");
+  e.hostname = tree.get("environment.hostname", "");
+  e.cpu_model = tree.get("environment.cpu_model", "");
+  e.cores = tree.get("environment.cores", 0u);
+  e.kernel = tree.get("environment.kernel", "");
+  e.compiler = tree.get("environment.compiler", "");
+  e.boost = tree.get("environment.boost", "");
+  e.git_rev = tree.get("environment.git_rev", "");
+  // Runs from before the field was recorded all used epoll
+  e.io_backend = tree.get("environment.io_backend", "epoll");
+
+  auto result = tree.get_child_optional("result");
+  if (!result)
+    throw std::runtime_error(path + ": no \"result\" object");
+
+  auto &r = report.result;
+  r.sent = result->get<uint64_t>("sent", 0);
+  r.received = result->get<uint64_t>("received", 0);
+  r.dropped = result->get<uint64_t>("dropped", 0);
+  r.undelivered = result->get<uint64_t>("undelivered", 0);
+  r.msg_per_sec = result->get<double>("msg_per_sec", 0);
+  r.delivered_per_sec = result->get<double>("delivered_per_sec", 0);
+  r.p50_ns = result->get<uint64_t>("p50_ns", 0);
+  r.p90_ns = result->get<uint64_t>("p90_ns", 0);
+  r.p95_ns = result->get<uint64_t>("p95_ns", 0);
+  r.p99_ns = result->get<uint64_t>("p99_ns", 0);
+  r.p999_ns = result->get<uint64_t>("p999_ns", 0);
+  r.max_ns = result->get<uint64_t>("max_ns", 0);
+  r.allocations = result->get<uint64_t>("allocations", 0);
+  return report;
+}
+
+std::vector<MetricDelta> compare(const BenchReport &baseline,
+                                 const BenchReport &current,
+                                 double threshold) {
+  const auto &b = baseline.result;
+  const auto &c = current.result;
+
+  auto delta = [threshold](const char *metric, double base, double cur,
+                           bool higher_is_better) {
+    double change = base > 0 ? (cur - base) / base : 0;
+    bool regression = higher_is_better ? change < -threshold
+                                       : change > threshold;
+    return MetricDelta{metric, base, cur, change, regression};
+  };
+
+  return {
+      delta("delivered_per_sec", b.delivered_per_sec, c.delivered_per_sec,
+            true),
+      delta("p50_ns", b.p50_ns, c.p50_ns, false),
+      delta("p99_ns", b.p99_ns, c.p99_ns, false),
+      delta("p999_ns", b.p999_ns, c.p999_ns, false),
+  };
+}
+
+std::vector<std::string> config_differences(const BenchConfig &a,
+                                            const BenchConfig &b) {
+  std::vector<std::string> diffs;
+  auto check = [&diffs](const char *field, const auto &x, const auto &y) {
+    if (x == y)
+      return;
+    std::ostringstream oss;
+    oss << field << ": " << x << " vs " << y;
+    diffs.push_back(oss.str());
+  };
+
+  check("nodes", a.nodes, b.nodes);
+  check("topology", a.topology, b.topology);
+  check("routing", a.routing, b.routing);
+  check("transport", a.transport, b.transport);
+  check("tuning", a.tuning, b.tuning);
+  check("pool_threads", a.pool_threads, b.pool_threads);
+  check("rate", a.rate, b.rate);
+  check("producers", a.producers, b.producers);
+  check("duration_s", a.duration_s, b.duration_s);
+  check("min_payload", a.min_payload, b.min_payload);
+  check("max_payload", a.max_payload, b.max_payload);
+  check("coalesce_us", a.coalesce_us, b.coalesce_us);
+  check("ramp", a.ramp, b.ramp);
+  return diffs;
+}
@@ -0,0 +1,330 @@
+#include "benchmark/topology.hpp"
+#include "core/local_transport.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <optional>
+#include <queue>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+// Collects edges without self-loops or duplicates
+class EdgeSet {
+public:
+  bool add(std::size_t a, std::size_t b) {
+    if (a == b)
+      return false;
+    return seen_.insert(std::minmax(a, b)).second;
+  }
+
+  bool contains(std::size_t a, std::size_t b) const {
+    return seen_.count(std::minmax(a, b)) != 0;
+  }
+
+  void remove(std::size_t a, std::size_t b) { seen_.erase(std::minmax(a, b)); }
+
+  std::vector<std::pair<std::size_t, std::size_t>> edges() const {
+    return {seen_.begin(), seen_.end()};
+  }
+
+private:
+  std::set<std::pair<std::size_t, std::size_t>> seen_;
+};
+
+Topology make(std::string name, std::size_t n, const EdgeSet &edges) {
+  Topology t;
+  t.name = std::move(name);
+  t.size = n;
+  t.edges = edges.edges();
+  return t;
+}
+
+} // namespace
+
+Topology Topology::star(std::size_t n, std::size_t center) {
+  // Leaves dial the center, like a server with clients
+  Topology t;
+  t.name = "star";
+  t.size = n;
+  for (std::size_t i = 0; i < n; ++i)
+    if (i != center)
+      t.edges.emplace_back(i, center);
+  return t;
+}
+
+Topology Topology::line(std::size_t n) {
+  EdgeSet e;
+  for (std::size_t i = 1; i < n; ++i)
+    e.add(i - 1, i);
+  return make("line", n, e);
+}
+
+Topology Topology::ring(std::size_t n) {
+  Topology t = line(n);
+  if (n > 2)
+    t.edges.emplace_back(n - 1, 0);
+  t.name = "ring";
+  return t;
+}
+
+Topology Topology::grid(std::size_t n) {
+  auto cols = static_cast<std::size_t>(std::ceil(std::sqrt(double(n))));
+  EdgeSet e;
+  for (std::size_t i = 0; i < n; ++i) {
+    if ((i + 1) % cols != 0 && i + 1 < n)
+      e.add(i, i + 1);
+    if (i + cols < n)
+      e.add(i, i + cols);
+  }
+  return make("grid", n, e);
+}
+
+Topology Topology::random_regular(std::size_t n, std::size_t k,
+                                  uint64_t seed) {
+  if (k >= n || (n * k) % 2 != 0)
+    throw std::invalid_argument("random_regular needs k < n and n*k even");
+
+  std::mt19937_64 rng(seed);
+  std::vector<std::size_t> stubs;
+
+  // Configuration model: pair up k stubs per node, retry on loops or
+  // multi-edges. Keep the best attempt if none comes out perfect.
+  EdgeSet best;
+  std::size_t best_edges = 0;
+  for (int attempt = 0; attempt < 100; ++attempt) {
+    stubs.clear();
+    for (std::size_t i = 0; i < n; ++i)
+      stubs.insert(stubs.end(), k, i);
+    std::shuffle(stubs.begin(), stubs.end(), rng);
+
+    EdgeSet e;
+    std::size_t added = 0;
+    for (std::size_t i = 0; i + 1 < stubs.size(); i += 2)
+      added += e.add(stubs[i], stubs[i + 1]);
+
+    if (added > best_edges) {
+      best = e;
+      best_edges = added;
+    }
+    if (added == n * k / 2)
+      break;
+  }
+
+  return make("random-regular", n, best);
+}
+
+Topology Topology::watts_strogatz(std::size_t n, std::size_t k, double beta,
+                                  uint64_t seed) {
+  if (k % 2 != 0 || k >= n)
+    throw std::invalid_argument("watts_strogatz needs an even k < n");
+
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  std::uniform_int_distribution<std::size_t> pick(0, n - 1);
+
+  EdgeSet e;
+  for (std::size_t i = 0; i < n; ++i)
+    for (std::size_t j = 1; j <= k / 2; ++j)
+      e.add(i, (i + j) % n);
+
+  // Rewire the far end of each lattice edge with probability beta
+  for (std::size_t j = 1; j <= k / 2; ++j) {
+    for (std::size_t i = 0; i < n; ++i) {
+      std::size_t old = (i + j) % n;
+      if (coin(rng) >= beta || !e.contains(i, old))
+        continue;
+
+      for (int tries = 0; tries < 16; ++tries) {
+        std::size_t target = pick(rng);
+        if (target != i && !e.contains(i, target)) {
+          e.remove(i, old);
+          e.add(i, target);
+          break;
+        }
+      }
+    }
+  }
+
+  return make("watts-strogatz", n, e);
+}
+
+Topology Topology::barabasi_albert(std::size_t n, std::size_t m,
+                                   uint64_t seed) {
+  if (m == 0 || m >= n)
+    throw std::invalid_argument("barabasi_albert needs 0 < m < n");
+
+  std::mt19937_64 rng(seed);
+  EdgeSet e;
+
+  // Every endpoint appears once per edge, so sampling from it is
+  // proportional to degree
+  std::vector<std::size_t> endpoints;
+
+  // Seed with a clique of m + 1 nodes
+  for (std::size_t i = 0; i <= m; ++i)
+    for (std::size_t j = i + 1; j <= m; ++j) {
+      e.add(i, j);
+      endpoints.push_back(i);
+      endpoints.push_back(j);
+    }
+
+  for (std::size_t v = m + 1; v < n; ++v) {
+    std::set<std::size_t> targets;
+    std::uniform_int_distribution<std::size_t> pick(0, endpoints.size() - 1);
+    while (targets.size() < m)
+      targets.insert(endpoints[pick(rng)]);
+
+    for (std::size_t t : targets) {
+      e.add(v, t);
+      endpoints.push_back(v);
+      endpoints.push_back(t);
+    }
+  }
+
+  return make("barabasi-albert", n, e);
+}
+
+Topology Topology::from_map(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("Cannot open topology map: " + path);
+
+  Topology t;
+  t.name = "map";
+
+  std::unordered_map<uint64_t, std::size_t> by_id;
+  std::unordered_map<uint16_t, std::size_t> by_port;
+  std::unordered_map<std::string, std::size_t> by_path;
+  // Targets are resolved once every node is declared
+  struct Link {
+    uint64_t from;
+    uint16_t port;
+    std::optional<LocalEndpoint> local;
+  };
+  std::vector<Link> links;
+
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream iss(line);
+    std::string cmd;
+    iss >> cmd;
+
+    if (cmd == "add") {
+      uint64_t id;
+      uint16_t port;
+      if (iss >> id >> port) {
+        by_id[id] = t.size;
+        by_port[port] = t.size;
+        std::string uri;
+        if (iss >> uri)
+          if (auto local = LocalEndpoint::parse(uri))
+            by_path[local->path] = t.size;
+        ++t.size;
+      }
+    } else if (cmd == "connect") {
+      uint64_t id;
+      std::string host;
+      uint16_t port;
+      if (!(iss >> id >> host))
+        continue;
+      if (auto local = LocalEndpoint::parse(host))
+        links.push_back({id, 0, local});
+      else if (iss >> port)
+        links.push_back({id, port, std::nullopt});
+    }
+  }
+
+  // Hosts are ignored: every node of the map runs locally
+  bool any_local = false;
+  for (auto &l : links) {
+    auto from = by_id.find(l.from);
+    std::size_t to = t.size;
+    if (l.local) {
+      auto it = by_path.find(l.local->path);
+      if (it != by_path.end())
+        to = it->second;
+    } else {
+      auto it = by_port.find(l.port);
+      if (it != by_port.end())
+        to = it->second;
+    }
+    if (from == by_id.end() || to == t.size)
+      throw std::runtime_error("Topology map links an undeclared node");
+
+    t.edges.emplace_back(from->second, to);
+    EdgeLink link = EdgeLink::Default;
+    if (l.local)
+      link = l.local->link == LocalLink::Shm ? EdgeLink::Shm : EdgeLink::Local;
+    any_local |= link != EdgeLink::Default;
+    t.links.push_back(link);
+  }
+  if (!any_local)
+    t.links.clear();
+
+  return t;
+}
+
+Topology Topology::parse(const std::string &spec, std::size_t n,
+                         uint64_t seed) {
+  std::vector<std::string> parts;
+  std::istringstream iss(spec);
+  for (std::string part; std::getline(iss, part, ':');)
+    parts.push_back(part);
+
+  const std::string kind = parts.empty() ? "" : parts[0];
+  auto arg = [&](std::size_t i) -> const std::string & {
+    if (i >= parts.size())
+      throw std::invalid_argument("Topology '" + kind + "' needs more arguments");
+    return parts[i];
+  };
+
+  if (kind == "star")
+    return star(n);
+  if (kind == "line")
+    return line(n);
+  if (kind == "ring")
+    return ring(n);
+  if (kind == "grid")
+    return grid(n);
+  if (kind == "regular")
+    return random_regular(n, std::stoul(arg(1)), seed);
+  if (kind == "ws")
+    return watts_strogatz(n, std::stoul(arg(1)), std::stod(arg(2)), seed);
+  if (kind == "ba")
+    return barabasi_albert(n, std::stoul(arg(1)), seed);
+  if (kind == "map")
+    // Paths may contain ':' themselves
+    return from_map(spec.substr(4));
+
+  throw std::invalid_argument("Unknown topology: " + spec);
+}
+
+std::vector<int> Topology::hops_from(std::size_t src) const {
+  std::vector<std::vector<std::size_t>> adj(size);
+  for (auto &[a, b] : edges) {
+    adj[a].push_back(b);
+    adj[b].push_back(a);
+  }
+
+  std::vector<int> hops(size, -1);
+  std::queue<std::size_t> q;
+  hops[src] = 0;
+  q.push(src);
+  while (!q.empty()) {
+    std::size_t u = q.front();
+    q.pop();
+    for (std::size_t v : adj[u]) {
+      if (hops[v] < 0) {
+        hops[v] = hops[u] + 1;
+        q.push(v);
+      }
+    }
+  }
+  return hops;
+}
@@ -0,0 +1,99 @@
+#include "core/buffer_pool.hpp"
+
+#include <utility>
+
+BufferPool::BufferPool(std::size_t max_cached_per_class)
+    : max_cached_(max_cached_per_class) {}
+
+BufferPool::~BufferPool()
+{
+    for (auto *head : free_)
+    {
+        while (head)
+        {
+            FreeBlock *next = head->next;
+            ::operator delete(head);
+            head = next;
+        }
+    }
+}
+
+std::size_t BufferPool::class_of_(std::size_t size)
+{
+    std::size_t c = 0;
+    while (c < size_classes.size() && size_classes[c] < size)
+        ++c;
+    return c;
+}
+
+void *BufferPool::allocate(std::size_t size)
+{
+    ++outstanding_;
+    std::size_t c = class_of_(size);
+    if (c == size_classes.size())
+    {
+        ++stats_.oversize;
+        return ::operator new(size);
+    }
+
+    if (FreeBlock *block = free_[c])
+    {
+        free_[c] = block->next;
+        --cached_[c];
+        ++stats_.hits;
+        return block;
+    }
+
+    ++stats_.misses;
+    return ::operator new(size_classes[c]);
+}
+
+void BufferPool::deallocate(void *p, std::size_t size)
+{
+    --outstanding_;
+    std::size_t c = class_of_(size);
+    if (c == size_classes.size() || cached_[c] >= max_cached_)
+    {
+        ::operator delete(p);
+        return;
+    }
+
+    auto *block = static_cast<FreeBlock *>(p);
+    block->next = free_[c];
+    free_[c] = block;
+    ++cached_[c];
+}
+
+PooledBuffer::PooledBuffer(BufferPool *pool, std::size_t size)
+    : pool_(pool), size_(size)
+{
+    if (size == 0)
+        return;
+    data_ = static_cast<uint8_t *>(pool ? pool->allocate(size) : ::operator new(size));
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer &&other) noexcept
+    : pool_(other.pool_), data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+PooledBuffer &PooledBuffer::operator=(PooledBuffer &&other) noexcept
+{
+    if (this != &other)
+    {
+        release_();
+        pool_ = other.pool_;
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+void PooledBuffer::release_()
+{
+    if (!data_)
+        return;
+    if (pool_)
+        pool_->deallocate(data_, size_);
+    else
+        ::operator delete(data_);
+    data_ = nullptr;
+}
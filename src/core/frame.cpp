@@ -0,0 +1,27 @@
+#include "core/frame.hpp"
+
+#include <cstring>
+
+Frame::Frame(const MessageHeader &header, PooledBuffer payload)
+    : header_(header), payload_(std::move(payload))
+{
+    header_.size = static_cast<uint32_t>(payload_.size());
+    encode_header(header_, kWireFixed, fixed_.data());
+    compact_size_ = static_cast<uint8_t>(encode_header(header_, kWireCompact, compact_.data()));
+}
+
+FramePtr Frame::make(BufferPool *pool, const MessageHeader &header, Span<const uint8_t> payload)
+{
+    PooledBuffer body(pool, payload.size());
+    if (!payload.empty())
+        std::memcpy(body.data(), payload.data(), payload.size());
+
+    if (pool)
+        return std::allocate_shared<Frame>(PoolAllocator<Frame>(*pool), header, std::move(body));
+    return std::make_shared<Frame>(header, std::move(body));
+}
+
+FramePtr Frame::make(BufferPool *pool, const Message &msg)
+{
+    return make(pool, msg.header, Span<const uint8_t>(msg.payload));
+}
@@ -0,0 +1,49 @@
+#include "core/io_pool.hpp"
+
+IoPool::IoPool(std::size_t threads, const SocketTuning &placement)
+{
+    if (threads == 0)
+        threads = 1;
+
+    contexts_.reserve(threads);
+    work_.reserve(threads);
+    threads_.reserve(threads);
+
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        // Concurrency hint of 1: each context is only ever run by one thread
+        contexts_.emplace_back(std::make_unique<boost::asio::io_context>(1));
+        work_.emplace_back(boost::asio::make_work_guard(*contexts_.back()));
+    }
+
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        boost::asio::io_context *ctx = contexts_[i].get();
+        threads_.emplace_back([ctx, i, placement]
+                              {
+            place_thread(placement, i);
+            ctx->run(); });
+    }
+}
+
+IoPool::~IoPool()
+{
+    stop();
+}
+
+boost::asio::io_context &IoPool::next()
+{
+    return *contexts_[next_.fetch_add(1, std::memory_order_relaxed) % contexts_.size()];
+}
+
+void IoPool::stop()
+{
+    for (auto &io : contexts_)
+        io->stop();
+
+    for (auto &t : threads_)
+    {
+        if (t.joinable())
+            t.join();
+    }
+}
@@ -0,0 +1,129 @@
+#include "core/local_transport.hpp"
+#include "core/shm_transport.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using boost::system::error_code;
+
+// Enough for the segment and both eventfds of a shared-memory link
+static constexpr std::size_t kMaxPassedFds = 4;
+
+std::optional<LocalEndpoint> LocalEndpoint::parse(const std::string &uri)
+{
+    static const std::string local = "local://";
+    static const std::string shm = "shm://";
+
+    if (uri.compare(0, local.size(), local) == 0 && uri.size() > local.size())
+        return LocalEndpoint{uri.substr(local.size()), LocalLink::Stream};
+    if (uri.compare(0, shm.size(), shm) == 0 && uri.size() > shm.size())
+        return LocalEndpoint{uri.substr(shm.size()), LocalLink::Shm};
+    return std::nullopt;
+}
+
+std::string LocalEndpoint::uri() const
+{
+    return (link == LocalLink::Shm ? "shm://" : "local://") + path;
+}
+
+LocalTransport::LocalTransport(local_socket socket, std::string remote)
+    : socket_(std::move(socket)), remote_(std::move(remote))
+{
+}
+
+void LocalTransport::async_read_some(boost::asio::mutable_buffer buffer, Handler handler)
+{
+    socket_.async_read_some(buffer, bind_memory(read_memory_, std::move(handler)));
+}
+
+void LocalTransport::async_write(ConstBuffers buffers, Handler handler)
+{
+    boost::asio::async_write(socket_, buffers, bind_memory(write_memory_, std::move(handler)));
+}
+
+void LocalTransport::close()
+{
+    error_code ignored;
+    socket_.close(ignored);
+}
+
+void send_preamble(local_socket &socket, LocalLink link, const std::vector<int> &fds)
+{
+    char tag = static_cast<char>(link);
+    iovec iov{&tag, 1};
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxPassedFds)] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (!fds.empty())
+    {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+        cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        std::memcpy(CMSG_DATA(c), fds.data(), sizeof(int) * fds.size());
+    }
+
+    ssize_t n;
+    do
+        n = ::sendmsg(socket.native_handle(), &msg, MSG_NOSIGNAL);
+    while (n < 0 && errno == EINTR);
+    if (n != 1)
+        throw std::runtime_error(std::string("local link preamble: ") + std::strerror(errno));
+}
+
+std::unique_ptr<Transport> open_local_link(local_socket socket, const LocalEndpoint &ep)
+{
+    if (ep.link == LocalLink::Shm)
+        return ShmTransport::dial(std::move(socket), ep.uri());
+
+    send_preamble(socket, LocalLink::Stream);
+    return std::make_unique<LocalTransport>(std::move(socket), ep.uri());
+}
+
+std::unique_ptr<Transport> accept_local_link(local_socket &socket, const std::string &path)
+{
+    char tag = 0;
+    iovec iov{&tag, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxPassedFds)];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do
+        n = ::recvmsg(socket.native_handle(), &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    while (n < 0 && errno == EINTR);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return nullptr;
+    if (n < 0)
+        throw std::runtime_error(std::string("local link preamble: ") + std::strerror(errno));
+
+    std::vector<int> fds;
+    for (cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+    {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+            continue;
+        std::size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        std::size_t at = fds.size();
+        fds.resize(at + count);
+        std::memcpy(fds.data() + at, CMSG_DATA(c), sizeof(int) * count);
+    }
+
+    if (n == 1 && tag == static_cast<char>(LocalLink::Shm) && !(msg.msg_flags & MSG_CTRUNC))
+        return ShmTransport::attach(std::move(socket), std::move(fds), "shm://" + path);
+
+    for (int fd : fds)
+        ::close(fd);
+    if (n == 1 && tag == static_cast<char>(LocalLink::Stream))
+        return std::make_unique<LocalTransport>(std::move(socket), "local://" + path);
+    throw std::runtime_error(n == 0 ? "peer hung up before the preamble" : "bad local link preamble");
+}
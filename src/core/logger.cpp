@@ -0,0 +1,205 @@
+#include "core/logger.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+static constexpr std::size_t kRingSize = 4096; // power of two
+
+struct LogRecord
+{
+    std::atomic<uint64_t> seq;
+    LogLevel level;
+    uint16_t size;
+    uint64_t time_ns;
+    char text[LogBuffer::capacity];
+};
+
+static const char *level_name(LogLevel level)
+{
+    static constexpr const char *names[] = {"TRACE", "DEBUG", "INFO ", "WARN ", "ERROR", "OFF  "};
+    return names[static_cast<std::size_t>(level)];
+}
+
+struct ThreadBuffer
+{
+    LogBuffer buffer;
+    std::ostream out{&buffer};
+};
+
+static ThreadBuffer &thread_buffer()
+{
+    thread_local ThreadBuffer tb;
+    return tb;
+}
+
+// Bounded MPSC ring (Vyukov): each slot's sequence number tells producers
+// whether it is free and the consumer whether it has been published
+struct Logger::Impl
+{
+    std::array<LogRecord, kRingSize> ring;
+    alignas(64) std::atomic<uint64_t> enqueue_pos{0};
+    alignas(64) std::atomic<uint64_t> dequeue_pos{0};
+
+    std::atomic<bool> running{true};
+    std::thread thread;
+    std::string out; // consumer-side batch
+};
+
+Logger &Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : impl_(std::make_unique<Impl>())
+{
+    for (std::size_t i = 0; i < kRingSize; ++i)
+        impl_->ring[i].seq.store(i, std::memory_order_relaxed);
+
+    if (const char *env = std::getenv("RELAY_LOG"))
+    {
+        LogLevel level;
+        if (parse_level(env, level))
+            level_.store(level, std::memory_order_relaxed);
+    }
+
+    impl_->thread = std::thread([this]
+                                { run_(); });
+}
+
+Logger::~Logger()
+{
+    impl_->running.store(false, std::memory_order_release);
+    if (impl_->thread.joinable())
+        impl_->thread.join();
+
+    write_pending_();
+    if (uint64_t lost = dropped())
+        std::fprintf(stderr, "logger: %llu lines dropped (ring full)\n", static_cast<unsigned long long>(lost));
+}
+
+bool Logger::parse_level(const std::string &name, LogLevel &level)
+{
+    static constexpr const char *names[] = {"trace", "debug", "info", "warn", "error", "off"};
+    for (std::size_t i = 0; i < std::size(names); ++i)
+    {
+        if (name == names[i])
+        {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Logger::push(LogLevel level, const char *text, std::size_t size)
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+
+    uint64_t pos = impl_->enqueue_pos.load(std::memory_order_relaxed);
+    LogRecord *record;
+    for (;;)
+    {
+        record = &impl_->ring[pos & (kRingSize - 1)];
+        uint64_t seq = record->seq.load(std::memory_order_acquire);
+        auto diff = static_cast<int64_t>(seq - pos);
+        if (diff == 0)
+        {
+            if (impl_->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // Full: the writer is behind, lose this line rather than wait
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = impl_->enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->level = level;
+    record->size = static_cast<uint16_t>(size);
+    record->time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    std::memcpy(record->text, text, size);
+    record->seq.store(pos + 1, std::memory_order_release);
+}
+
+bool Logger::write_pending_()
+{
+    auto &out = impl_->out;
+    out.clear();
+
+    uint64_t pos = impl_->dequeue_pos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        LogRecord &record = impl_->ring[pos & (kRingSize - 1)];
+        if (record.seq.load(std::memory_order_acquire) != pos + 1)
+            break;
+
+        std::time_t secs = static_cast<std::time_t>(record.time_ns / 1'000'000'000);
+        std::tm tm{};
+        gmtime_r(&secs, &tm);
+        char stamp[48];
+        std::size_t n = std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+        std::snprintf(stamp + n, sizeof(stamp) - n, ".%06llu ",
+                      static_cast<unsigned long long>(record.time_ns / 1000 % 1'000'000));
+
+        out += stamp;
+        out += level_name(record.level);
+        out += ' ';
+        out.append(record.text, record.size);
+        out += '\n';
+
+        record.seq.store(pos + kRingSize, std::memory_order_release);
+        ++pos;
+    }
+
+    if (out.empty())
+        return false;
+    std::fwrite(out.data(), 1, out.size(), stderr);
+    std::fflush(stderr);
+
+    // Published after the write so flush() returns once lines are out
+    impl_->dequeue_pos.store(pos, std::memory_order_release);
+    return true;
+}
+
+void Logger::run_()
+{
+    while (impl_->running.load(std::memory_order_acquire))
+    {
+        if (!write_pending_())
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+void Logger::flush()
+{
+    uint64_t target = impl_->enqueue_pos.load(std::memory_order_acquire);
+    while (impl_->dequeue_pos.load(std::memory_order_acquire) < target &&
+           impl_->running.load(std::memory_order_acquire))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+LogLine::LogLine(LogLevel level)
+    : level_(level),
+      buffer_(thread_buffer().buffer),
+      out_(thread_buffer().out)
+{
+    buffer_.reset();
+    out_.clear(); // a truncated line leaves badbit set
+}
+
+LogLine::~LogLine()
+{
+    Logger::instance().push(level_, buffer_.data(), buffer_.size());
+}
@@ -0,0 +1,250 @@
+#include "core/memory_transport.hpp"
+#include "core/handler_memory.hpp"
+
+using boost::system::error_code;
+
+static std::atomic<uint64_t> next_pair_id{1};
+
+// One endpoint: the ring it reads from and its operation in progress
+struct MemorySide
+{
+    MemorySide(boost::asio::any_io_executor executor, std::size_t capacity)
+        : storage(capacity), inbox(index, storage.data(), capacity), ex(std::move(executor)) {}
+
+    RingIndex index;
+    std::vector<uint8_t> storage;
+    ByteRing inbox; // written by the other side
+    boost::asio::any_io_executor ex;
+
+    // Held while posting to `ex`, so nothing is posted once the side closed
+    // (its io_context may be going away)
+    std::mutex mutex;
+    std::atomic<bool> closed{false};
+
+    // Set by the owner when it has to wait; whoever clears one owes a wakeup
+    std::atomic<bool> read_parked{false};
+    std::atomic<bool> write_parked{false};
+
+    // Owner thread only
+    boost::asio::mutable_buffer read_buffer;
+    Transport::Handler read_handler;
+    Transport::ConstBuffers write_buffers; // the writer's array, kept valid until completion
+    std::size_t write_index = 0;
+    std::size_t write_offset = 0;
+    std::size_t written = 0;
+    Transport::Handler write_handler;
+
+    // One of each can be in flight, so their posts reuse these blocks
+    HandlerMemory read_done;
+    HandlerMemory write_done;
+    HandlerMemory read_wake;  // posted by the other side
+    HandlerMemory write_wake; // posted by the other side
+};
+
+struct MemoryTransport::Shared
+{
+    Shared(boost::asio::any_io_executor a, boost::asio::any_io_executor b, std::size_t capacity)
+        : first(std::move(a), capacity), second(std::move(b), capacity),
+          id(next_pair_id.fetch_add(1, std::memory_order_relaxed)) {}
+
+    MemorySide &side(int i) { return i ? second : first; }
+
+    MemorySide first;
+    MemorySide second;
+    uint64_t id;
+};
+
+template <typename Fn>
+static void wake(MemorySide &target, std::atomic<bool> &parked, HandlerMemory &memory, Fn fn)
+{
+    // Pairs with the fence between parking and re-checking in try_*_
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!parked.load(std::memory_order_relaxed) || !parked.exchange(false))
+        return;
+
+    std::lock_guard<std::mutex> lock(target.mutex);
+    if (!target.closed.load())
+        post_with_memory(target.ex, memory, std::move(fn));
+}
+
+static void complete(MemorySide &side, Transport::Handler &handler, HandlerMemory &memory, error_code ec, std::size_t n)
+{
+    post_with_memory(side.ex, memory, [h = std::move(handler), ec, n]() mutable
+                     { h(ec, n); });
+    handler = nullptr;
+}
+
+std::pair<std::unique_ptr<MemoryTransport>, std::unique_ptr<MemoryTransport>>
+MemoryTransport::make_pair(boost::asio::any_io_executor a, boost::asio::any_io_executor b, std::size_t capacity)
+{
+    auto shared = std::make_shared<Shared>(std::move(a), std::move(b), round_up_pow2(std::max<std::size_t>(capacity, 64)));
+    return {std::unique_ptr<MemoryTransport>(new MemoryTransport(shared, 0)),
+            std::unique_ptr<MemoryTransport>(new MemoryTransport(shared, 1))};
+}
+
+MemoryTransport::MemoryTransport(std::shared_ptr<Shared> shared, int side)
+    : shared_(std::move(shared)), side_(side) {}
+
+MemoryTransport::~MemoryTransport()
+{
+    close();
+}
+
+void MemoryTransport::async_read_some(boost::asio::mutable_buffer buffer, Handler handler)
+{
+    MemorySide &me = shared_->side(side_);
+    me.read_buffer = buffer;
+    me.read_handler = std::move(handler);
+    if (buffer.size() == 0)
+    {
+        complete(me, me.read_handler, me.read_done, {}, 0);
+        return;
+    }
+    try_read_(shared_, side_);
+}
+
+void MemoryTransport::async_write(ConstBuffers buffers, Handler handler)
+{
+    MemorySide &me = shared_->side(side_);
+    me.write_buffers = buffers;
+    me.write_index = 0;
+    me.write_offset = 0;
+    me.written = 0;
+    me.write_handler = std::move(handler);
+    try_write_(shared_, side_);
+}
+
+void MemoryTransport::try_read_(const std::shared_ptr<Shared> &shared, int side)
+{
+    MemorySide &me = shared->side(side);
+    MemorySide &peer = shared->side(1 - side);
+    if (!me.read_handler)
+        return; // a stale wakeup
+
+    for (;;)
+    {
+        if (me.closed)
+        {
+            complete(me, me.read_handler, me.read_done, boost::asio::error::operation_aborted, 0);
+            return;
+        }
+
+        std::size_t n = me.inbox.read(static_cast<uint8_t *>(me.read_buffer.data()), me.read_buffer.size());
+        if (n > 0)
+        {
+            complete(me, me.read_handler, me.read_done, {}, n);
+            // Room freed up for a writer waiting on it
+            wake(peer, peer.write_parked, peer.write_wake, [shared, other = 1 - side]
+                 { try_write_(shared, other); });
+            return;
+        }
+        if (peer.closed)
+        {
+            complete(me, me.read_handler, me.read_done, boost::asio::error::eof, 0);
+            return;
+        }
+
+        me.read_parked.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (me.inbox.empty() && !peer.closed.load())
+            return;
+        // Data or a close slipped in; unless the writer already claimed the
+        // wakeup, handle it here
+        if (!me.read_parked.exchange(false))
+            return;
+    }
+}
+
+void MemoryTransport::try_write_(const std::shared_ptr<Shared> &shared, int side)
+{
+    MemorySide &me = shared->side(side);
+    MemorySide &peer = shared->side(1 - side);
+    if (!me.write_handler)
+        return;
+
+    for (;;)
+    {
+        if (me.closed)
+        {
+            complete(me, me.write_handler, me.write_done, boost::asio::error::operation_aborted, me.written);
+            return;
+        }
+        if (peer.closed)
+        {
+            complete(me, me.write_handler, me.write_done, boost::asio::error::broken_pipe, me.written);
+            return;
+        }
+
+        bool moved = false;
+        while (me.write_index < me.write_buffers.size())
+        {
+            const auto &b = me.write_buffers[me.write_index];
+            std::size_t n = peer.inbox.write(static_cast<const uint8_t *>(b.data()) + me.write_offset,
+                                             b.size() - me.write_offset);
+            me.written += n;
+            me.write_offset += n;
+            moved |= n > 0;
+            if (me.write_offset < b.size())
+                break;
+            ++me.write_index;
+            me.write_offset = 0;
+        }
+
+        if (moved)
+            wake(peer, peer.read_parked, peer.read_wake, [shared, other = 1 - side]
+                 { try_read_(shared, other); });
+
+        if (me.write_index == me.write_buffers.size())
+        {
+            complete(me, me.write_handler, me.write_done, {}, me.written);
+            return;
+        }
+
+        me.write_parked.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (peer.inbox.full() && !peer.closed.load())
+            return;
+        if (!me.write_parked.exchange(false))
+            return;
+    }
+}
+
+void MemoryTransport::close()
+{
+    MemorySide &me = shared_->side(side_);
+    MemorySide &peer = shared_->side(1 - side_);
+    {
+        std::lock_guard<std::mutex> lock(me.mutex);
+        if (me.closed)
+            return;
+        me.closed.store(true);
+    }
+
+    // The peer's read sees end of stream, its write a broken pipe
+    wake(peer, peer.read_parked, peer.read_wake, [shared = shared_, other = 1 - side_]
+         { try_read_(shared, other); });
+    wake(peer, peer.write_parked, peer.write_wake, [shared = shared_, other = 1 - side_]
+         { try_write_(shared, other); });
+
+    // Our own parked operations are aborted here, whether or not a wakeup
+    // was claimed for them: none will be posted now that we are closed
+    me.read_parked.store(false);
+    me.write_parked.store(false);
+    try_read_(shared_, side_);
+    try_write_(shared_, side_);
+}
+
+bool MemoryTransport::is_open() const
+{
+    return !shared_->side(side_).closed.load(std::memory_order_relaxed);
+}
+
+boost::asio::any_io_executor MemoryTransport::get_executor()
+{
+    return shared_->side(side_).ex;
+}
+
+std::string MemoryTransport::remote() const
+{
+    return "memory#" + std::to_string(shared_->id) + (side_ ? "a" : "b");
+}
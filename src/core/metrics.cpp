@@ -0,0 +1,100 @@
+#include "core/metrics.hpp"
+
+static void family(std::ostream &out, const char *name, const char *type, const char *help)
+{
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n';
+}
+
+template <typename Get>
+static void node_family(std::ostream &out, const std::vector<NodeStats> &nodes,
+                        const char *name, const char *type, const char *help, Get get)
+{
+    family(out, name, type, help);
+    for (const auto &n : nodes)
+        out << name << "{node=\"" << n.id << "\"} " << get(n) << '\n';
+}
+
+template <typename Get>
+static void connection_family(std::ostream &out, const std::vector<NodeStats> &nodes,
+                              const char *name, const char *type, const char *help, Get get)
+{
+    family(out, name, type, help);
+    // conn is the connection's own id: a position in the peer list moves
+    // when another connection goes away, and its series would move with it
+    for (const auto &n : nodes)
+    {
+        for (const auto &c : n.connections)
+        {
+            out << name << "{node=\"" << n.id << "\",conn=\"" << c.id << "\",peer=\"" << c.remote << '"';
+            if (c.node_id)
+                out << ",peer_node=\"" << *c.node_id << '"';
+            out << "} " << get(c) << '\n';
+        }
+    }
+}
+
+void write_prometheus(std::ostream &out, const std::vector<NodeStats> &nodes)
+{
+    node_family(out, nodes, "relay_messages_received_total", "counter",
+                "Frames handed to the router by connections",
+                [](const NodeStats &n) { return n.routing.received; });
+    node_family(out, nodes, "relay_messages_duplicate_total", "counter",
+                "Frames discarded as already seen or originated here",
+                [](const NodeStats &n) { return n.routing.duplicates; });
+    node_family(out, nodes, "relay_messages_delivered_total", "counter",
+                "Messages delivered to this node",
+                [](const NodeStats &n) { return n.routing.delivered; });
+    node_family(out, nodes, "relay_messages_forwarded_total", "counter",
+                "Messages relayed toward other nodes",
+                [](const NodeStats &n) { return n.routing.forwarded; });
+    node_family(out, nodes, "relay_messages_originated_total", "counter",
+                "Messages sent by this node",
+                [](const NodeStats &n) { return n.routing.originated; });
+    node_family(out, nodes, "relay_messages_ttl_expired_total", "counter",
+                "Messages not relayed because their TTL ran out",
+                [](const NodeStats &n) { return n.routing.ttl_expired; });
+    node_family(out, nodes, "relay_frames_dropped_total", "counter",
+                "Frames lost to full write queues or failed connections",
+                [](const NodeStats &n) { return n.routing.dropped; });
+    node_family(out, nodes, "relay_bytes_received_total", "counter",
+                "Bytes read from all connections",
+                [](const NodeStats &n) { return n.bytes_in; });
+    node_family(out, nodes, "relay_bytes_sent_total", "counter",
+                "Bytes written to all connections",
+                [](const NodeStats &n) { return n.bytes_out; });
+    node_family(out, nodes, "relay_peers", "gauge",
+                "Connections of the node",
+                [](const NodeStats &n) { return n.connections.size(); });
+
+    connection_family(out, nodes, "relay_connection_frames_received_total", "counter",
+                      "Frames read from the connection",
+                      [](const ConnectionStats &c) { return c.frames_in; });
+    connection_family(out, nodes, "relay_connection_bytes_received_total", "counter",
+                      "Bytes read from the connection",
+                      [](const ConnectionStats &c) { return c.bytes_in; });
+    connection_family(out, nodes, "relay_connection_frames_sent_total", "counter",
+                      "Frames written to the connection",
+                      [](const ConnectionStats &c) { return c.frames_out; });
+    connection_family(out, nodes, "relay_connection_bytes_sent_total", "counter",
+                      "Bytes written to the connection",
+                      [](const ConnectionStats &c) { return c.bytes_out; });
+    connection_family(out, nodes, "relay_connection_writes_total", "counter",
+                      "Gather writes issued on the connection",
+                      [](const ConnectionStats &c) { return c.writes; });
+    connection_family(out, nodes, "relay_connection_frames_dropped_total", "counter",
+                      "Frames the connection discarded",
+                      [](const ConnectionStats &c) { return c.dropped; });
+    connection_family(out, nodes, "relay_connection_queue_frames", "gauge",
+                      "Frames waiting in the write queue",
+                      [](const ConnectionStats &c) { return c.queued_frames; });
+    connection_family(out, nodes, "relay_connection_queue_bytes", "gauge",
+                      "Bytes waiting in the write queue",
+                      [](const ConnectionStats &c) { return c.queued_bytes; });
+    connection_family(out, nodes, "relay_connection_open", "gauge",
+                      "1 while the connection is usable",
+                      [](const ConnectionStats &c) { return c.open ? 1 : 0; });
+    connection_family(out, nodes, "relay_connection_standby", "gauge",
+                      "1 while the connection duplicates another link to the same node",
+                      [](const ConnectionStats &c) { return c.standby ? 1 : 0; });
+}
@@ -1,88 +1,489 @@
 #include "core//node.hpp"
 #include "core/peer_connection.hpp"
+#include "core/logger.hpp"
+#include "core/trace.hpp"
+#include "core/wire.hpp"
 
-Node::Node(uint64_t id, uint16_t port)
-    : io_(),
+#include <future>
+#include <unistd.h>
+#include <unordered_set>
+
+static std::string describe(const DialTarget &target)
+{
+    if (auto *local = std::get_if<LocalEndpoint>(&target))
+        return local->uri();
+    const auto &ep = std::get<tcp::endpoint>(target);
+    return ep.address().to_string() + ":" + std::to_string(ep.port());
+}
+
+FramePtr Delivery::retain() const
+{
+    // The copy holds the bare payload, without the trace extension
+    MessageHeader copy = header;
+    copy.flags &= ~kFlagTraced;
+    return Frame::make(nullptr, copy, payload);
+}
+
+Node::Node(uint64_t id, std::optional<uint16_t> port, const SocketTuning &tuning)
+    : Node(id, port, tuning, std::make_unique<boost::asio::io_context>(), nullptr)
+{
+}
+
+Node::Node(uint64_t id, std::optional<uint16_t> port, IoPool &pool, const SocketTuning &tuning)
+    : Node(id, port, tuning, nullptr, &pool.next())
+{
+}
+
+Node::Node(uint64_t id, std::optional<uint16_t> port, const SocketTuning &tuning,
+           std::unique_ptr<boost::asio::io_context> own_io, boost::asio::io_context *shared_io)
+    : own_io_(std::move(own_io)),
+      io_(shared_io ? *shared_io : *own_io_),
       work_(boost::asio::make_work_guard(io_)),
-      acceptor_(io_, tcp::endpoint(tcp::v4(), port)),
+      acceptor_(io_),
+      local_acceptor_(io_),
       router_(id, peers_, *this),
       id_(id),
-      receive_handler_(default_receive_handler)
+      tuning_(tuning),
+      jitter_(static_cast<std::minstd_rand::result_type>(id))
+{
+    set_receive_handler(default_receive_handler);
+    if (!port)
+        return;
+
+    tcp::endpoint ep(tcp::v4(), *port);
+    acceptor_.open(ep.protocol());
+    acceptor_.set_option(tcp::acceptor::reuse_address(true));
+    apply_tuning(acceptor_, tuning_);
+    acceptor_.bind(ep);
+    acceptor_.listen();
+    LOG_DEBUG("[NODE " << id_ << "] listening on port " << *port);
+}
+
+uint16_t Node::get_port() const
+{
+    boost::system::error_code ec;
+    auto ep = acceptor_.local_endpoint(ec);
+    return ec ? 0 : ep.port();
+}
+
+void Node::listen_local(const std::string &path)
 {
-    std::cout << this->id_ << " is initialised" << std::endl;
+    if (local_acceptor_.is_open())
+        throw std::logic_error("node " + std::to_string(id_) + " already listens on " + local_path_);
+
+    boost::asio::local::stream_protocol::endpoint ep(path);
+    ::unlink(path.c_str());
+    local_acceptor_.open(ep.protocol());
+    local_acceptor_.bind(ep);
+    local_acceptor_.listen();
+    local_path_ = path;
+    LOG_DEBUG("[NODE " << id_ << "] listening on local://" << path);
+
+    // The acceptor is not touched on the io thread before this runs
+    boost::asio::post(io_, [this]
+                      { local_accept_loop_(); });
 }
 
 Node::~Node()
 {
-    io_.stop();
-    if (thread_.joinable())
-        thread_.join();
+    if (own_io_)
+    {
+        io_.stop();
+        if (thread_.joinable())
+            thread_.join();
+        // With the io thread gone this thread owns the peers; closing them
+        // stops in-process links from waking a context that is going away
+        stopping_ = true;
+        peers_.for_each_link([](auto &peer)
+                             { peer->close(); });
+        if (!local_path_.empty())
+            ::unlink(local_path_.c_str());
+        return;
+    }
+
+    // Shared context: the pool outlives us, so close our sockets on the io
+    // thread and wait until their aborted completions have run. Composed
+    // writes finish a step later than the barrier, so the connections are
+    // waited for until the last one is gone.
+    if (!local_path_.empty())
+        ::unlink(local_path_.c_str());
+    if (io_.stopped())
+        return;
+
+    std::promise<void> drained;
+    boost::asio::post(io_, [this, &drained]
+                      {
+        stopping_ = true;
+        boost::system::error_code ec;
+        acceptor_.close(ec);
+        local_acceptor_.close(ec);
+        for (auto &timer : redial_timers_)
+            timer->cancel();
+        for (auto &socket : dialing_)
+            socket->close(ec);
+        for (auto &socket : local_pending_)
+            socket->close(ec);
+        peers_.for_each_link([](auto &peer)
+                             { peer->close(); });
+        boost::asio::post(io_, [&drained]
+                          { drained.set_value(); }); });
+    drained.get_future().wait();
+
+    std::unique_lock<std::mutex> lock(connections_mutex_);
+    connections_gone_.wait(lock, [this]
+                           { return live_connections_ == 0; });
+    if (buffer_pool_.outstanding() != 0)
+        LOG_ERROR("[NODE " << id_ << "] " << buffer_pool_.outstanding() << " frame blocks still out at shutdown");
 }
 
 void Node::set_receive_handler(ReceiveHandler handler)
 {
-    receive_handler_ = std::move(handler);
+    set_delivery_handler([handler = std::move(handler)](uint64_t node_id, const Delivery &delivery)
+                         {
+        std::string text(delivery.payload.begin(), delivery.payload.end());
+        handler(node_id, delivery.header.src_node_id, text); });
+}
+
+void Node::set_delivery_handler(DeliveryHandler handler)
+{
+    delivery_handler_ = std::move(handler);
+}
+
+void Node::set_connection_options(const ConnectionOptions &options)
+{
+    block_when_congested_.store(options.overflow_policy == OverflowPolicy::Block,
+                                std::memory_order_relaxed);
+
+    // Only read on the io thread when a connection is created
+    boost::asio::post(io_, [this, options]
+                      { connection_options_ = options; });
+}
+
+NodeStats Node::stats()
+{
+    // Never waits for the io thread, which may not be running: counters are
+    // atomics and the connection list is the copy the PeerManager publishes
+    NodeStats s;
+    s.id = id_;
+    s.routing = router_.stats();
+
+    for (auto &link : peers_.links())
+    {
+        ConnectionStats c = link.peer->stats();
+        c.node_id = link.node_id;
+        c.standby = c.open && link.standby;
+        s.bytes_in += c.bytes_in;
+        s.bytes_out += c.bytes_out;
+        s.queued_frames += c.queued_frames;
+        s.queued_bytes += c.queued_bytes;
+        s.connections.push_back(std::move(c));
+    }
+    return s;
 }
 
 void Node::default_receive_handler(uint64_t node_id, uint64_t from_id, const std::string &message)
 {
-    std::cout << "[NODE " << node_id << "] received from " << from_id << ": " << message << std::endl;
+    LOG_INFO("[NODE " << node_id << "] received from " << from_id << ": " << message);
 }
 
 void Node::run()
 {
+    if (!own_io_)
+    {
+        boost::asio::post(io_, [this]
+                          { accept_loop(); });
+        return;
+    }
+
     accept_loop();
     thread_ = std::thread([this]
-                          { io_.run(); });
+                          {
+        place_thread(tuning_, id_);
+        io_.run(); });
+}
+
+std::shared_ptr<PeerConnection> Node::adopt_(std::unique_ptr<Transport> transport,
+                                             std::size_t max_read_buffer)
+{
+    // connection_options_ is only read here, on the io thread
+    ConnectionOptions options = connection_options_;
+    options.read_buffer_size = std::min(options.read_buffer_size, max_read_buffer);
+    auto *connection = new PeerConnection(std::move(transport), router_, options);
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        ++live_connections_;
+    }
+    // Should this throw, the deleter has already run and balanced the count
+    std::shared_ptr<PeerConnection> peer(connection, [this](PeerConnection *p)
+                                         {
+        delete p;
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        if (--live_connections_ == 0)
+            connections_gone_.notify_all(); });
+    peers_.add(peer);
+    peer->start();
+    return peer;
 }
 
 void Node::accept_loop()
 {
+    if (!acceptor_.is_open())
+        return;
+
     acceptor_.async_accept([this](boost::system::error_code ec, tcp::socket socket)
                            {
+        if (ec == boost::asio::error::operation_aborted || !acceptor_.is_open())
+            return;
         if (!ec) {
-            std::cout << "\n[NODE " << this->id_ << "] Accepted connection from " 
-                      << socket.remote_endpoint() << std::endl;
-            auto peer = std::make_shared<PeerConnection>(std::move(socket), router_);
-            peers_.add(peer);
-            peer->start();
+            LOG_DEBUG("[NODE " << id_ << "] accepted connection from " << socket.remote_endpoint(ec));
+            apply_tuning(socket, tuning_);
+            adopt_(make_tcp_transport(std::move(socket)));
         }
         accept_loop(); });
 }
 
+void Node::local_accept_loop_()
+{
+    if (!local_acceptor_.is_open())
+        return;
+
+    local_acceptor_.async_accept([this](boost::system::error_code ec, local_socket socket)
+                                 {
+        if (ec == boost::asio::error::operation_aborted || !local_acceptor_.is_open())
+            return;
+        if (!ec)
+            read_preamble_(std::make_shared<local_socket>(std::move(socket)));
+        local_accept_loop_(); });
+}
+
+void Node::read_preamble_(std::shared_ptr<local_socket> socket)
+{
+    local_pending_.insert(socket);
+    socket->async_wait(local_socket::wait_read, [this, socket](boost::system::error_code ec)
+                       {
+        local_pending_.erase(socket);
+        if (ec || stopping_)
+            return;
+        try {
+            auto transport = accept_local_link(*socket, local_path_);
+            if (!transport) {
+                read_preamble_(socket);
+                return;
+            }
+            LOG_DEBUG("[NODE " << id_ << "] accepted " << transport->remote() << " connection");
+            adopt_(std::move(transport));
+        } catch (const std::exception &e) {
+            LOG_WARN("[NODE " << id_ << "] dropped local connection: " << e.what());
+        } });
+}
+
 void Node::connect(const tcp::endpoint &ep)
 {
-    std::cout << "trying to connect 0" << std::endl;
+    LOG_TRACE("[NODE " << id_ << "] connecting to " << ep);
+    boost::asio::post(io_, [this, ep]
+                      { dial_(ep, 0); });
+}
+
+void Node::connect(const LocalEndpoint &ep)
+{
+    // Throws here, on the caller's thread, if the path does not fit
+    boost::asio::local::stream_protocol::endpoint check(ep.path);
+
+    LOG_TRACE("[NODE " << id_ << "] connecting to " << ep.uri());
+    boost::asio::post(io_, [this, ep]
+                      { dial_(ep, 0); });
+}
+
+void Node::connect(Node &peer, std::size_t capacity)
+{
+    LOG_TRACE("[NODE " << id_ << "] linking in-process to node " << peer.id_);
 
-    auto socket_ptr = std::make_shared<tcp::socket>(io_);
-    std::cout << "trying to connect 1" << std::endl;
+    // Each end is adopted on its own node's io thread
+    // A read never returns more than the ring holds, so a larger receive
+    // buffer would only cost memory
+    auto [mine, theirs] = MemoryTransport::make_pair(io_.get_executor(), peer.io_.get_executor(), capacity);
+    boost::asio::post(io_, [this, t = std::move(mine), capacity]() mutable
+                      { adopt_(std::move(t), capacity); });
+    boost::asio::post(peer.io_, [&peer, t = std::move(theirs), capacity]() mutable
+                      { peer.adopt_(std::move(t), capacity); });
+}
 
-    socket_ptr->async_connect(ep, [this, socket_ptr, ep](boost::system::error_code ec) mutable
-                              {
-            std::cout << "io stopped? " << io_.stopped() << std::endl;
+void Node::set_reconnect_policy(const ReconnectPolicy &policy)
+{
+    boost::asio::post(io_, [this, policy]
+                      { reconnect_ = policy; });
+}
+
+void Node::dial_(const DialTarget &target, unsigned attempt)
+{
+    if (auto *local = std::get_if<LocalEndpoint>(&target))
+    {
+        dial_local_(*local, attempt);
+        return;
+    }
+
+    const auto &ep = std::get<tcp::endpoint>(target);
+    auto socket = std::make_shared<tcp::socket>(io_);
+    // Open early so the buffer sizes count for the window scale of the SYN
+    boost::system::error_code ec;
+    socket->open(ep.protocol(), ec);
+    if (ec)
+    {
+        dial_failed_(ep, attempt, ec.message());
+        return;
+    }
+    apply_tuning(*socket, tuning_);
+    dialing_.insert(socket);
+    socket->async_connect(ep, [this, socket, ep, attempt](boost::system::error_code ec)
+                          {
+        dialing_.erase(socket);
+        if (stopping_)
+            return;
         if (!ec) {
-            auto peer = std::make_shared<PeerConnection>(std::move(*socket_ptr), router_);
-            peers_.add(peer);
-            peer->start();
-            std::cout << "\n[NODE " << this->id_ << "] Connected to " << ep << std::endl;
-        } else {
-            std::cerr << "\n[NODE " << this->id_ << "] Connection failed: " << ec.message() << std::endl;
-        } });
+            auto peer = adopt_(make_tcp_transport(std::move(*socket)));
+            outbound_.emplace(peer.get(), ep);
+            LOG_DEBUG("[NODE " << id_ << "] connected to " << ep);
+            return;
+        }
+
+        dial_failed_(ep, attempt, ec.message()); });
+}
+
+void Node::dial_local_(const LocalEndpoint &ep, unsigned attempt)
+{
+    auto socket = std::make_shared<local_socket>(io_);
+    local_pending_.insert(socket);
+    socket->async_connect(boost::asio::local::stream_protocol::endpoint(ep.path),
+                          [this, socket, ep, attempt](boost::system::error_code ec)
+                          {
+        local_pending_.erase(socket);
+        if (stopping_)
+            return;
+        std::string error = ec.message();
+        if (!ec) {
+            try {
+                auto peer = adopt_(open_local_link(std::move(*socket), ep));
+                outbound_.emplace(peer.get(), ep);
+                LOG_DEBUG("[NODE " << id_ << "] connected to " << ep.uri());
+                return;
+            } catch (const std::exception &e) {
+                error = e.what();
+            }
+        }
+        dial_failed_(ep, attempt, error); });
+}
+
+void Node::dial_failed_(const DialTarget &target, unsigned attempt, const std::string &error)
+{
+    LOG_WARN("[NODE " << id_ << "] connection to " << describe(target) << " failed: " << error);
+    if (reconnect_.enabled)
+        redial_(target, attempt + 1);
+}
+
+void Node::redial_(const DialTarget &target, unsigned attempt)
+{
+    auto delay = reconnect_.initial_delay * (1u << std::min(attempt, 16u));
+    delay = std::min(delay, reconnect_.max_delay);
+    // Anywhere in the upper half of the backoff
+    delay = delay / 2 + std::chrono::milliseconds(
+                            std::uniform_int_distribution<int64_t>(0, delay.count() / 2)(jitter_));
+
+    auto timer = std::make_shared<boost::asio::steady_timer>(io_, delay);
+    redial_timers_.insert(timer);
+    LOG_DEBUG("[NODE " << id_ << "] redialing " << describe(target) << " in " << delay.count() << "ms");
+    timer->async_wait([this, timer, target, attempt](boost::system::error_code ec)
+                      {
+        redial_timers_.erase(timer);
+        if (!ec && !stopping_)
+            dial_(target, attempt); });
+}
+
+void Node::on_peer_closed(PeerConnection *peer)
+{
+    // Deferred: the connection may be closing in the middle of a fan-out
+    // over the peers
+    boost::asio::post(io_, [this, self = peer->shared_from_this()]
+                      {
+        peers_.remove(self.get());
+
+        auto it = outbound_.find(self.get());
+        if (it == outbound_.end())
+            return;
+        DialTarget target = it->second;
+        outbound_.erase(it);
+
+        LOG_DEBUG("[NODE " << id_ << "] lost connection to " << describe(target));
+        if (reconnect_.enabled && !stopping_ && self->remote_id() != id_)
+            redial_(target, 0); });
 }
 
 void Node::send(uint64_t dst, std::string_view data)
 {
+    // Backpressure for producers; the io thread itself must never stall
+    if (block_when_congested_.load(std::memory_order_relaxed) &&
+        !io_.get_executor().running_in_this_thread())
+    {
+        auto backoff = std::chrono::microseconds(1);
+        while (router_.congested() && !io_.stopped())
+        {
+            std::this_thread::sleep_for(backoff);
+            backoff = std::min(backoff * 2, std::chrono::microseconds(1000));
+        }
+    }
+
     Message msg;
     msg.header.type = static_cast<uint16_t>(MessageType::Data);
     msg.header.src_node_id = id_;
     msg.header.dst_node_id = dst;
-    msg.header.ttl = 2;
-    msg.header.size = data.size();
+    msg.header.seq = next_seq_.fetch_add(1, std::memory_order_relaxed);
+    msg.header.ttl = ttl_.load(std::memory_order_relaxed);
+
+    if (Tracer::instance().sample())
+    {
+        TraceExtension ext{Tracer::make_trace_id(id_, msg.header.seq), Tracer::now_ns()};
+        msg.header.flags |= kFlagTraced;
+        msg.payload.resize(sizeof(ext));
+        encode_trace_extension(ext, msg.payload.data());
+    }
+    msg.payload.insert(msg.payload.end(), data.begin(), data.end());
+    msg.header.size = msg.payload.size();
+
+    if (io_.get_executor().running_in_this_thread())
+    {
+        router_.originate(msg);
+        return;
+    }
+
+    // Peers and their write queues belong to the io thread; hand the message
+    // over and wake it with at most one post per batch
+    submissions_.push(std::move(msg));
+    if (!drain_scheduled_.exchange(true))
+        boost::asio::post(io_, bind_memory(drain_memory_, [this]
+                                           { drain_submissions_(); }));
+}
 
-    msg.payload.assign(data.begin(), data.end());
+void Node::drain_submissions_()
+{
+    constexpr std::size_t max_batch = 1024;
+
+    // Shutting down: a drain queued behind the close must not repost itself
+    // past the destructor's barrier; ~MpscQueue frees what is left
+    if (stopping_)
+        return;
+
+    // Cleared before draining: a push that misses this batch will post again
+    drain_scheduled_.store(false);
+
+    Message msg;
+    std::size_t n = 0;
+    while (n < max_batch && submissions_.pop(msg))
+    {
+        router_.originate(msg);
+        ++n;
+    }
 
-    // std::cout << "\n[NODE " << id_ << "] Sending message to " << dst
-    //   << " via peers" << std::endl;
-    peers_.for_each([&](auto &peer)
-                    { peer->async_send(msg); });
+    // Let other handlers on this thread run before the next batch
+    if (n == max_batch && !drain_scheduled_.exchange(true))
+        boost::asio::post(io_, bind_memory(drain_memory_, [this]
+                                           { drain_submissions_(); }));
 }
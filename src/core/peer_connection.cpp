@@ -1,84 +1,446 @@
 #include "core/peer_connection.hpp"
 #include "core/router.hpp"
+#include "core/logger.hpp"
+
+#include <algorithm>
+#include <cstring>
 
 using boost::asio::buffer;
 using boost::system::error_code;
 
-PeerConnection::PeerConnection(tcp::socket socket, Router &router)
-    : socket_(std::move(socket)), router_(router) {}
+static std::atomic<uint32_t> next_connection_id{1};
+
+PeerConnection::PeerConnection(std::unique_ptr<Transport> transport, Router &router, const ConnectionOptions &options)
+    : transport_(std::move(transport)),
+      router_(router),
+      options_(options),
+      remote_(transport_->remote()),
+      id_(next_connection_id.fetch_add(1, std::memory_order_relaxed)),
+      read_buffer_(std::max(options.read_buffer_size, kMaxHeaderSize)),
+      coalesce_timer_(transport_->get_executor()),
+      heartbeat_timer_(transport_->get_executor())
+{
+    if (options_.max_batch_frames == 0)
+        options_.max_batch_frames = 1;
+    write_buffers_.reserve(options_.max_batch_frames * 2);
+}
+
+ConnectionStats PeerConnection::stats() const
+{
+    ConnectionStats s;
+    s.id = id_;
+    s.remote = remote_;
+    s.open = !failed_.load(std::memory_order_relaxed);
+    s.frames_in = frames_in_.value();
+    s.bytes_in = bytes_in_.value();
+    s.frames_out = frames_out_.value();
+    s.bytes_out = bytes_out_.value();
+    s.writes = writes_.value();
+    s.dropped = dropped_.value();
+    s.queued_frames = queued_frames_.value();
+    s.queued_bytes = queued_bytes();
+    return s;
+}
 
 void PeerConnection::start()
 {
-    read_header_();
+    // Introduce ourselves so the other side can tell duplicate links apart
+    send_control_(MessageType::Hello);
+    read_some_();
+    if (options_.heartbeat_interval.count() > 0)
+        heartbeat_();
 }
 
-void PeerConnection::read_header_()
+void PeerConnection::close()
 {
+    fail_();
+}
+
+void PeerConnection::send_control_(MessageType type)
+{
+    MessageHeader header;
+    header.type = static_cast<uint16_t>(type);
+    header.src_node_id = router_.self_id();
+    // A Hello's body is the newest wire version we read
+    uint8_t version = kWireVersion;
+    Span<const uint8_t> body;
+    if (type == MessageType::Hello)
+        body = Span<const uint8_t>(&version, 1);
+    async_send(Frame::make(nullptr, header, body));
+}
+
+void PeerConnection::heartbeat_()
+{
+    heartbeat_timer_.expires_after(options_.heartbeat_interval);
     auto self = shared_from_this();
-    boost::asio::async_read(
-        socket_,
-        buffer(&header_, sizeof(header_)),
-        [this, self](error_code ec, std::size_t)
+    heartbeat_timer_.async_wait([this, self](error_code ec)
+                                {
+        if (ec || failed_)
+            return;
+
+        silent_for_ = heard_ ? std::chrono::milliseconds(0) : silent_for_ + options_.heartbeat_interval;
+        heard_ = false;
+        if (options_.idle_timeout.count() > 0 && silent_for_ >= options_.idle_timeout)
         {
-            if (!ec)
-            {
-                body_.resize(header_.size);
-                read_body_();
-            }
-        });
+            LOG_WARN("[NODE " << router_.self_id() << "] conn " << id_ << " (" << remote_ << ") silent for "
+                              << silent_for_.count() << "ms, closing");
+            fail_();
+            return;
+        }
+
+        // Traffic from the peer already proves the link; only probe silence
+        if (silent_for_.count() > 0)
+            send_control_(MessageType::Ping);
+        heartbeat_(); });
 }
 
-void PeerConnection::read_body_()
+void PeerConnection::read_some_()
 {
-    auto self = shared_from_this();
-    boost::asio::async_read(
-        socket_,
-        buffer(body_),
-        [this, self](error_code ec, std::size_t)
+    // Handlers capture nothing but `self`, which fits the inline storage of
+    // Transport::Handler
+    transport_->async_read_some(
+        buffer(read_buffer_.data() + read_end_, read_buffer_.size() - read_end_),
+        [self = shared_from_this()](error_code ec, std::size_t n)
+        { self->on_read_(ec, n); });
+}
+
+void PeerConnection::on_read_(error_code ec, std::size_t n)
+{
+    if (ec)
+    {
+        fail_();
+        return;
+    }
+
+    read_end_ += n;
+    bytes_in_.add(n);
+    heard_ = true;
+    if (Tracer::enabled())
+        read_ts_ = Tracer::now_ns();
+    parse_frames_();
+    // A frame may have closed us. The buffer is not compacted then, and a
+    // full one would ask for zero bytes, which completes at once and
+    // would keep the connection alive reading nothing.
+    if (!failed_)
+        read_some_();
+}
+
+void PeerConnection::parse_frames_()
+{
+    // Hand every complete frame in the buffer to the router
+    MessageHeader header;
+    std::size_t header_size = 0;
+    while (!failed_ && read_begin_ < read_end_)
+    {
+        WireStatus status =
+            decode_header(read_buffer_.data() + read_begin_, read_end_ - read_begin_, header, header_size);
+        if (status == WireStatus::Incomplete)
+            break;
+        if (status == WireStatus::Malformed || header.size > options_.max_frame_size)
+        {
+            LOG_WARN("[NODE " << router_.self_id() << "] conn " << id_ << " (" << remote_ << ") sent "
+                              << (status == WireStatus::Malformed ? "a malformed header"
+                                                                  : "a frame over the size limit")
+                              << ", closing");
+            fail_();
+            return;
+        }
+
+        std::size_t frame_size = header_size + header.size;
+        if (read_end_ - read_begin_ < frame_size)
+            break;
+
+        // The payload is handed out straight from the receive buffer
+        const uint8_t *body = read_buffer_.data() + read_begin_ + header_size;
+        read_begin_ += frame_size;
+        frames_in_.add();
+
+        if (header.type != static_cast<uint16_t>(MessageType::Data))
+        {
+            handle_control_(header, Span<const uint8_t>(body, header.size));
+            continue;
+        }
+
+        if (header.flags & kFlagTraced && Tracer::enabled())
+            Tracer::instance().record(TraceStage::ReadComplete,
+                                      Tracer::trace_id_of(header, Span<const uint8_t>(body, header.size)),
+                                      router_.self_id(), id_, read_ts_);
+
+        router_.on_message(header, Span<const uint8_t>(body, header.size), this);
+    }
+
+    if (failed_)
+        return;
+    if (read_begin_ == read_end_)
+    {
+        read_begin_ = read_end_ = 0;
+        return;
+    }
+
+    // A partial frame is left; make room for the rest of it. Bytes are only
+    // moved when the frame would otherwise run past the end of the buffer.
+    std::size_t needed = kMaxHeaderSize;
+    if (decode_header(read_buffer_.data() + read_begin_, read_end_ - read_begin_, header, header_size) ==
+        WireStatus::Ok)
+        needed = header_size + header.size;
+
+    if (read_begin_ + needed > read_buffer_.size())
+    {
+        std::memmove(read_buffer_.data(), read_buffer_.data() + read_begin_, read_end_ - read_begin_);
+        read_end_ -= read_begin_;
+        read_begin_ = 0;
+
+        if (needed > read_buffer_.size())
+            read_buffer_.resize(needed);
+    }
+}
+
+void PeerConnection::handle_control_(const MessageHeader &header, Span<const uint8_t> body)
+{
+    // Reading either already counted as hearing from the peer
+    if (header.type == static_cast<uint16_t>(MessageType::Ping))
+    {
+        send_control_(MessageType::Pong);
+        return;
+    }
+    if (header.type == static_cast<uint16_t>(MessageType::Pong))
+        return;
+    if (header.type != static_cast<uint16_t>(MessageType::Hello))
+    {
+        LOG_DEBUG("conn " << id_ << ": ignoring frame of unknown type " << header.type);
+        return;
+    }
+    if (remote_id_)
+        return;
+
+    // Peers from before versioning send an empty Hello and read fixed headers only
+    if (!body.empty() && body[0] > kWireFixed)
+        wire_version_ = std::min(body[0], kWireVersion);
+
+    remote_id_ = uint64_t{header.src_node_id}; // copied: the packed field is unaligned
+    if (header.src_node_id == router_.self_id())
+    {
+        // Never filed with the peers; the node sees remote_id() == self_id on close
+        LOG_WARN("[NODE " << router_.self_id() << "] closing connection to itself via " << remote_);
+        fail_();
+        return;
+    }
+
+    bool active = router_.on_hello(this, header.src_node_id);
+    LOG_DEBUG("[NODE " << router_.self_id() << "] conn " << id_ << " (" << remote_ << ") is node "
+                       << header.src_node_id << (active ? "" : ", standing by as a duplicate link"));
+}
+
+void PeerConnection::async_send(FramePtr frame)
+{
+    if (failed_)
+    {
+        drop_(1);
+        return;
+    }
+
+    if (!has_room_(frame->size()) && !make_room_(frame->size()))
+        return;
+
+    queued_bytes_.fetch_add(frame->size(), std::memory_order_relaxed);
+    trace_(TraceStage::Enqueue, *frame);
+    write_queue_.push_back(std::move(frame));
+    queued_frames_.set(write_queue_.size());
+
+    if (full_())
+        set_congested_(true);
+
+    schedule_write_();
+}
+
+bool PeerConnection::has_room_(std::size_t frame_size) const
+{
+    return write_queue_.size() < options_.max_queue_frames &&
+           queued_bytes() + frame_size <= options_.max_queue_bytes;
+}
+
+bool PeerConnection::full_() const
+{
+    return write_queue_.size() >= options_.max_queue_frames ||
+           queued_bytes() >= options_.max_queue_bytes;
+}
+
+bool PeerConnection::make_room_(std::size_t frame_size)
+{
+    switch (options_.overflow_policy)
+    {
+    case OverflowPolicy::DropOldest:
+    {
+        // Frames already handed to the socket must stay put
+        std::size_t first = in_flight_;
+        std::size_t last = first;
+        std::size_t frames = write_queue_.size();
+        std::size_t bytes = queued_bytes();
+        while (last < write_queue_.size() &&
+               (frames >= options_.max_queue_frames || bytes + frame_size > options_.max_queue_bytes))
         {
-            if (!ec)
-            {
-                Message msg;
-                msg.header = header_;
-                msg.payload = std::move(body_);
-                router_.on_message(msg, this);
-                read_header_();
-            }
-        });
+            bytes -= write_queue_[last]->size();
+            --frames;
+            ++last;
+        }
+
+        drop_(last - first);
+        write_queue_.erase(first, last - first);
+        queued_frames_.set(write_queue_.size());
+        queued_bytes_.store(bytes, std::memory_order_relaxed);
+        if (has_room_(frame_size))
+            return true;
+        break;
+    }
+    case OverflowPolicy::Disconnect:
+        drop_(1);
+        fail_();
+        return false;
+    case OverflowPolicy::Block:
+    case OverflowPolicy::DropNewest:
+        break;
+    }
+
+    drop_(1);
+    return false;
+}
+
+void PeerConnection::drop_(std::size_t frames)
+{
+    if (frames == 0)
+        return;
+    dropped_.add(frames);
+    router_.on_dropped(frames);
 }
 
-void PeerConnection::async_send(const Message &msg)
+void PeerConnection::trace_(TraceStage stage, const Frame &frame, uint64_t ts_ns)
 {
-    std::vector<uint8_t> buffer_data(sizeof(MessageHeader) + msg.payload.size());
-    std::memcpy(buffer_data.data(), &msg.header, sizeof(MessageHeader));
-    std::memcpy(buffer_data.data() + sizeof(MessageHeader),
-                msg.payload.data(),
-                msg.payload.size());
+    if (frame.header().flags & kFlagTraced && Tracer::enabled())
+        Tracer::instance().record(stage, Tracer::trace_id_of(frame.header(), frame.payload()),
+                                  router_.self_id(), id_, ts_ns);
+}
 
-    bool writing = !write_queue_.empty();
-    write_queue_.push_back(std::move(buffer_data));
+void PeerConnection::set_congested_(bool congested)
+{
+    if (congested_ == congested)
+        return;
+    congested_ = congested;
+    router_.on_congestion(congested);
+}
+
+void PeerConnection::fail_()
+{
+    // Everything still queued is lost, and so is everything sent from now on.
+    // Frames being written stay alive until the write handler releases them.
+    if (failed_)
+        return;
+    failed_ = true;
 
-    if (!writing)
+    std::size_t bytes = 0;
+    for (std::size_t i = 0; i < in_flight_; ++i)
+        bytes += write_queue_[i]->size();
+    drop_(write_queue_.size() - in_flight_);
+    write_queue_.truncate(in_flight_);
+    queued_frames_.set(write_queue_.size());
+    queued_bytes_.store(bytes, std::memory_order_relaxed);
+    set_congested_(false);
+
+    coalesce_timer_.cancel();
+    heartbeat_timer_.cancel();
+    transport_->close();
+
+    router_.on_closed(this);
+}
+
+void PeerConnection::schedule_write_()
+{
+    if (writing_)
+        return;
+
+    if (options_.coalesce_window.count() == 0)
     {
         write_next_();
+        return;
+    }
+
+    if (coalescing_)
+    {
+        // A full batch is ready, no point in waiting for the window to close
+        if (write_queue_.size() >= options_.max_batch_frames)
+            coalesce_timer_.cancel();
+        return;
     }
+
+    coalescing_ = true;
+    coalesce_timer_.expires_after(options_.coalesce_window);
+    auto self = shared_from_this();
+    coalesce_timer_.async_wait(bind_memory(coalesce_memory_, [this, self](error_code)
+                                           {
+        coalescing_ = false;
+        if (!writing_ && !write_queue_.empty() && transport_->is_open())
+            write_next_(); }));
 }
 
 void PeerConnection::write_next_()
 {
-    auto self = shared_from_this();
-    boost::asio::async_write(
-        socket_,
-        buffer(write_queue_.front()),
-        [this, self](error_code ec, std::size_t)
+    // Drain as much of the queue as the caps allow into one vectored write
+    write_buffers_.clear();
+    std::size_t bytes = 0;
+    in_flight_ = 0;
+    for (std::size_t i = 0; i < write_queue_.size(); ++i)
+    {
+        const auto &frame = write_queue_[i];
+        if (in_flight_ == options_.max_batch_frames ||
+            (in_flight_ > 0 && bytes + frame->size() > options_.max_batch_bytes))
+            break;
+
+        for (const auto &b : frame->buffers(wire_version_))
+            write_buffers_.push_back(b);
+        bytes += frame->size();
+        ++in_flight_;
+    }
+
+    // write_buffers_ stays untouched until on_write_, so the transport
+    // writes straight from it
+    writing_ = true;
+    transport_->async_write(write_buffers_, [self = shared_from_this()](error_code ec, std::size_t n)
+                            { self->on_write_(ec, n); });
+}
+
+void PeerConnection::on_write_(error_code ec, std::size_t n)
+{
+    std::size_t written = in_flight_;
+    uint64_t done_ns = !ec && Tracer::enabled() ? Tracer::now_ns() : 0;
+    for (std::size_t i = 0; i < written; ++i)
+    {
+        queued_bytes_.fetch_sub(write_queue_[i]->size(), std::memory_order_relaxed);
+        if (done_ns)
+            trace_(TraceStage::WriteComplete, *write_queue_[i], done_ns);
+    }
+    write_queue_.pop_front(written);
+    queued_frames_.set(write_queue_.size());
+    in_flight_ = 0;
+    writing_ = false;
+
+    if (ec)
+    {
+        drop_(written);
+        fail_();
+        return;
+    }
+
+    frames_out_.add(written);
+    bytes_out_.add(n);
+    writes_.add();
+
+    if (!failed_)
+    {
+        if (!full_())
+            set_congested_(false);
+        // Whatever queued up meanwhile is already a batch, send it now
+        if (!write_queue_.empty())
         {
-            if (!ec)
-            {
-                write_queue_.pop_front();
-                if (!write_queue_.empty())
-                {
-                    write_next_();
-                }
-            }
-        });
+            write_next_();
+        }
+    }
 }
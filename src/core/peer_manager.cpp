@@ -1,19 +1,109 @@
 #include "core/peer_manager.hpp"
 #include "core/peer_connection.hpp"
 
+#include <algorithm>
+
+// Moves the last element into the hole at `index` and tells it where it went
+template <typename Slot>
+static void swap_remove(std::vector<std::shared_ptr<PeerConnection>> &v, uint32_t index, Slot slot)
+{
+    if (index + 1 != v.size())
+    {
+        v[index] = std::move(v.back());
+        slot(*v[index]) = index;
+    }
+    v.pop_back();
+}
+
 void PeerManager::add(std::shared_ptr<PeerConnection> peer)
 {
-    peers_.insert(peer);
+    peer->slot_.link = static_cast<uint32_t>(links_.size());
+    links_.push_back(peer);
+    // Unidentified connections take part in fan-out until their handshake
+    activate_(peer);
+    publish_();
 }
 
 void PeerManager::remove(PeerConnection *peer)
 {
-    for (auto it = peers_.begin(); it != peers_.end(); ++it)
+    PeerSlot &slot = peer->slot_;
+    if (slot.link == PeerSlot::npos)
+        return;
+
+    // Keeps the connection alive while it is taken out of the lists
+    auto owned = links_[slot.link];
+    swap_remove(links_, slot.link, [](PeerConnection &p) -> uint32_t &
+                { return p.slot_.link; });
+    slot.link = PeerSlot::npos;
+
+    bool was_active = slot.active != PeerSlot::npos;
+    if (was_active)
+        deactivate_(peer);
+
+    if (slot.filed)
     {
-        if (it->get() == peer)
-        {
-            peers_.erase(it);
-            return;
-        }
+        auto it = by_node_.find(*peer->remote_id());
+        auto &links = it->second;
+        links.erase(std::find(links.begin(), links.end(), owned));
+        slot.filed = false;
+
+        if (links.empty())
+            by_node_.erase(it);
+        else if (was_active)
+            activate_(links.front()); // promote the first standby link
     }
+    publish_();
+}
+
+bool PeerManager::identify(PeerConnection *peer, uint64_t node_id)
+{
+    PeerSlot &slot = peer->slot_;
+    if (slot.link == PeerSlot::npos || slot.filed)
+        return false;
+
+    auto &links = by_node_[node_id];
+    links.push_back(links_[slot.link]);
+    slot.filed = true;
+
+    bool first = links.size() == 1;
+    if (!first)
+        deactivate_(peer);
+    publish_();
+    return first;
+}
+
+std::shared_ptr<PeerConnection> PeerManager::find(uint64_t node_id) const
+{
+    auto it = by_node_.find(node_id);
+    return it == by_node_.end() ? nullptr : it->second.front();
+}
+
+std::vector<PeerManager::LinkInfo> PeerManager::links() const
+{
+    std::lock_guard lk(published_mtx_);
+    return published_;
+}
+
+void PeerManager::activate_(const std::shared_ptr<PeerConnection> &peer)
+{
+    peer->slot_.active = static_cast<uint32_t>(active_.size());
+    active_.push_back(peer);
+}
+
+void PeerManager::deactivate_(PeerConnection *peer)
+{
+    swap_remove(active_, peer->slot_.active, [](PeerConnection &p) -> uint32_t &
+                { return p.slot_.active; });
+    peer->slot_.active = PeerSlot::npos;
+}
+
+void PeerManager::publish_()
+{
+    std::vector<LinkInfo> links;
+    links.reserve(links_.size());
+    for (auto &p : links_)
+        links.push_back({p, p->remote_id(), p->slot_.active == PeerSlot::npos});
+
+    std::lock_guard lk(published_mtx_);
+    published_.swap(links);
 }
@@ -2,39 +2,129 @@
 #include "core/peer_connection.hpp"
 #include "core/peer_manager.hpp"
 #include "core/node.hpp"
-#include <iostream>
+#include "core/logger.hpp"
+#include "core/trace.hpp"
 
 Router::Router(uint64_t self_id, PeerManager &peers, Node &node)
     : self_id_(self_id), peers_(peers), node_(node) {}
 
-void Router::on_message(Message msg, PeerConnection *from)
+RouterStats Router::stats() const
 {
-    if (msg.header.dst_node_id == self_id_)
+    RouterStats s;
+    s.received = received_.value();
+    s.duplicates = duplicates_.value();
+    s.delivered = delivered_.value();
+    s.forwarded = forwarded_.value();
+    s.originated = originated_.value();
+    s.ttl_expired = ttl_expired_.value();
+    s.dropped = dropped_.value();
+    return s;
+}
+
+void Router::on_message(const MessageHeader &header, Span<const uint8_t> body, PeerConnection *from)
+{
+    received_.add();
+
+    // Sampled messages carry a trace extension ahead of the payload; the
+    // flag decides, not the id, so a zero id from another build is stripped too
+    Span<const uint8_t> payload = body;
+    uint64_t trace_id = 0;
+    if (header.flags & kFlagTraced && body.size() >= sizeof(TraceExtension))
+    {
+        trace_id = Tracer::trace_id_of(header, body);
+        payload = body.subspan(sizeof(TraceExtension));
+    }
+    auto trace = [&](TraceStage stage)
+    {
+        if (trace_id && Tracer::enabled())
+            Tracer::instance().record(stage, trace_id, self_id_);
+    };
+
+    // Our own message echoed back by a cycle, or a copy that took another path
+    if (header.src_node_id == self_id_ ||
+        seen_.check_and_insert(header.src_node_id, header.seq))
     {
-        std::string text(msg.payload.begin(), msg.payload.end());
-        // Use the receive handler callback
-        node_.get_receive_handler()(self_id_, msg.header.src_node_id, text);
+        duplicates_.add();
+        trace(TraceStage::Duplicate);
         return;
     }
-    else
+
+    if (from && mode() == RoutingMode::Learned)
+        routes_.learn(header.src_node_id, from->shared_from_this());
+
+    if (header.dst_node_id == self_id_)
     {
-        std::string text(msg.payload.begin(), msg.payload.end());
-        // !DEBUG: Use the receive handler callback
-        std::cout << "[WASSIT]:" << msg.header.src_node_id << " -> " << self_id_ << " -> " << msg.header.dst_node_id << std::endl;
+        // Use the delivery handler callback, straight from the receive buffer
+        delivered_.add();
+        trace(TraceStage::Deliver);
+        node_.get_delivery_handler()(self_id_, Delivery{header, payload});
+        return;
     }
 
-    if (msg.header.ttl == 0)
+    LOG_TRACE("relay " << header.src_node_id << " -> " << self_id_ << " -> " << header.dst_node_id);
+
+    if (header.ttl == 0)
+    {
+        ttl_expired_.add();
+        trace(TraceStage::Expired);
         return;
+    }
 
-    msg.header.ttl--;
-    forward(msg, from);
+    // Copied once into pooled storage, then shared by every outgoing peer
+    MessageHeader next = header;
+    next.ttl--;
+    forwarded_.add();
+    trace(TraceStage::Forward);
+    forward(Frame::make(&node_.buffer_pool(), next, body), from);
 }
 
-void Router::forward(Message &msg, PeerConnection *from)
+void Router::originate(const Message &msg)
 {
+    originated_.add();
+    if (msg.header.flags & kFlagTraced && Tracer::enabled())
+        Tracer::instance().record(TraceStage::Originate, Tracer::trace_id_of(msg.header, msg.payload), self_id_);
+    forward(Frame::make(&node_.buffer_pool(), msg), nullptr);
+}
+
+bool Router::on_hello(PeerConnection *from, uint64_t node_id)
+{
+    return peers_.identify(from, node_id);
+}
+
+void Router::on_closed(PeerConnection *peer)
+{
+    node_.on_peer_closed(peer);
+}
+
+bool Router::same_node_(const PeerConnection &peer, const PeerConnection *from)
+{
+    if (!from)
+        return false;
+    if (&peer == from)
+        return true;
+    return peer.remote_id() && peer.remote_id() == from->remote_id();
+}
+
+void Router::forward(const FramePtr &frame, PeerConnection *from)
+{
+    if (mode() == RoutingMode::Learned)
+    {
+        // A direct neighbour needs no table; otherwise the learned next hop.
+        // Never bounce a message back where it came from; flood instead.
+        auto next_hop = peers_.find(frame->header().dst_node_id);
+        if (!next_hop)
+            next_hop = routes_.lookup(frame->header().dst_node_id);
+        if (next_hop && !next_hop->failed() && !same_node_(*next_hop, from))
+        {
+            next_hop->async_send(frame);
+            return;
+        }
+    }
+
+    // One link per neighbour: duplicate links to a node carry nothing extra
     peers_.for_each([&](auto &peer)
                     {
-        if (peer.get() != from) {
-            peer->async_send(msg);
+        if (!same_node_(*peer, from)) {
+            peer->async_send(frame);
         } });
 }
@@ -0,0 +1,26 @@
+#include "core/routing_table.hpp"
+
+RoutingTable::RoutingTable(std::chrono::milliseconds max_age)
+    : max_age_(max_age) {}
+
+void RoutingTable::learn(uint64_t node_id, const std::shared_ptr<PeerConnection> &via)
+{
+    auto &route = routes_[node_id];
+    route.via = via;
+    route.updated = clock::now();
+}
+
+std::shared_ptr<PeerConnection> RoutingTable::lookup(uint64_t node_id)
+{
+    auto it = routes_.find(node_id);
+    if (it == routes_.end())
+        return nullptr;
+
+    auto peer = it->second.via.lock();
+    if (!peer || clock::now() - it->second.updated > max_age_)
+    {
+        routes_.erase(it);
+        return nullptr;
+    }
+    return peer;
+}
@@ -0,0 +1,107 @@
+#include "core/seen_cache.hpp"
+
+#include <algorithm>
+
+static constexpr std::size_t kInitialRing = 64;
+
+SeenCache::SeenCache(std::size_t capacity, std::chrono::milliseconds max_age)
+    : capacity_(capacity ? capacity : 1), max_age_(max_age)
+{
+    resize_(std::min(capacity_, kInitialRing));
+}
+
+void SeenCache::resize_(std::size_t ring_size)
+{
+    // Entries move to the front of the new ring, oldest first
+    std::vector<Entry> ring(ring_size);
+    for (std::size_t i = 0; i < count_; ++i)
+        ring[i] = ring_[(head_ + i) % ring_.size()];
+    ring_ = std::move(ring);
+    head_ = 0;
+
+    // Keep the index at most half full so probe chains stay short
+    std::size_t slots = 1;
+    while (slots < ring_.size() * 2)
+        slots <<= 1;
+
+    index_.assign(slots, 0);
+    mask_ = slots - 1;
+    for (std::size_t i = 0; i < count_; ++i)
+        index_[find_slot_(ring_[i].src, ring_[i].seq)] = static_cast<uint32_t>(i + 1);
+}
+
+uint64_t SeenCache::hash_(uint64_t src, uint32_t seq)
+{
+    uint64_t h = src * 0x9E3779B97F4A7C15ull ^ seq;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+std::size_t SeenCache::find_slot_(uint64_t src, uint32_t seq) const
+{
+    std::size_t slot = hash_(src, seq) & mask_;
+    while (index_[slot] != 0)
+    {
+        const Entry &e = ring_[index_[slot] - 1];
+        if (e.src == src && e.seq == seq)
+            return slot;
+        slot = (slot + 1) & mask_;
+    }
+    return slot;
+}
+
+bool SeenCache::check_and_insert(uint64_t src, uint32_t seq)
+{
+    auto now = clock::now();
+
+    while (count_ > 0 && now - ring_[head_].seen > max_age_)
+        evict_oldest_();
+
+    std::size_t slot = find_slot_(src, seq);
+    if (index_[slot] != 0)
+        return true;
+
+    if (count_ == ring_.size())
+    {
+        if (ring_.size() < capacity_)
+            resize_(std::min(ring_.size() * 2, capacity_));
+        else
+            evict_oldest_();
+        slot = find_slot_(src, seq);
+    }
+
+    std::size_t pos = (head_ + count_) % ring_.size();
+    ring_[pos] = Entry{src, seq, now};
+    index_[slot] = static_cast<uint32_t>(pos + 1);
+    ++count_;
+    return false;
+}
+
+void SeenCache::evict_oldest_()
+{
+    const Entry &e = ring_[head_];
+    erase_slot_(find_slot_(e.src, e.seq));
+    head_ = (head_ + 1) % ring_.size();
+    --count_;
+}
+
+void SeenCache::erase_slot_(std::size_t slot)
+{
+    // Backward-shift deletion keeps linear probing free of tombstones
+    index_[slot] = 0;
+    std::size_t next = (slot + 1) & mask_;
+    while (index_[next] != 0)
+    {
+        const Entry &e = ring_[index_[next] - 1];
+        std::size_t home = hash_(e.src, e.seq) & mask_;
+        if (((next - home) & mask_) >= ((next - slot) & mask_))
+        {
+            index_[slot] = index_[next];
+            index_[next] = 0;
+            slot = next;
+        }
+        next = (next + 1) & mask_;
+    }
+}
@@ -0,0 +1,418 @@
+#include "core/shm_transport.hpp"
+#include "core/byte_ring.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+using boost::system::error_code;
+
+static constexpr uint64_t kShmMagic = 0x72656c6179736d31; // "relaysm1"
+
+// Shared by both processes, at the start of the segment
+struct ShmFlags
+{
+    alignas(64) std::atomic<uint32_t> closed{0};
+    // Set by the owner when it has to wait; whoever clears one owes a wakeup
+    std::atomic<uint32_t> read_parked{0};
+    std::atomic<uint32_t> write_parked{0};
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared flags must be lock-free");
+
+struct ShmLayout
+{
+    uint64_t magic = kShmMagic;
+    uint64_t capacity = 0;
+    ShmFlags side[2];
+    RingIndex inbox[2];
+    // Followed by the ring storage: inbox[0], then inbox[1]
+};
+
+// Owns a file descriptor until released
+class UniqueFd
+{
+public:
+    explicit UniqueFd(int fd = -1) : fd_(fd) {}
+    ~UniqueFd()
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+    UniqueFd(const UniqueFd &) = delete;
+    UniqueFd &operator=(const UniqueFd &) = delete;
+
+    int get() const { return fd_; }
+    int release() { return std::exchange(fd_, -1); }
+
+private:
+    int fd_;
+};
+
+static std::runtime_error sys_error(const std::string &what)
+{
+    return std::runtime_error("shm transport: " + what + ": " + std::strerror(errno));
+}
+
+struct ShmTransport::State
+{
+    // Takes ownership of the mapping and both eventfds. capacity is the
+    // validated ring size, never re-read from the shared layout.
+    State(local_socket control_socket, void *base, std::size_t length, std::size_t capacity, int side,
+          int own_wake, int peer_wake, std::string remote)
+        : control(std::move(control_socket)),
+          wake(control.get_executor(), own_wake),
+          peer_wake(peer_wake),
+          base(base),
+          length(length),
+          capacity(capacity),
+          layout(static_cast<ShmLayout *>(base)),
+          me(layout->side[side]),
+          peer(layout->side[1 - side]),
+          inbox(layout->inbox[side], ring_data(side), capacity),
+          outbox(layout->inbox[1 - side], ring_data(1 - side), capacity),
+          remote(std::move(remote))
+    {
+    }
+
+    ~State()
+    {
+        ::munmap(base, length);
+        ::close(peer_wake);
+    }
+
+    uint8_t *ring_data(int side) const
+    {
+        return static_cast<uint8_t *>(base) + sizeof(ShmLayout) + side * capacity;
+    }
+
+    // Wakes the peer if it parked on `flag`
+    void notify(std::atomic<uint32_t> &flag)
+    {
+        // Pairs with the fence between parking and re-checking
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!flag.load(std::memory_order_relaxed) || !flag.exchange(0))
+            return;
+        uint64_t one = 1;
+        ssize_t ignored = ::write(peer_wake, &one, sizeof(one));
+        (void)ignored; // the counter cannot overflow at one per wakeup
+    }
+
+    // At most one of each in flight. Declared before the descriptors whose
+    // operations they hold.
+    HandlerMemory read_done;
+    HandlerMemory write_done;
+    HandlerMemory wait_memory;
+
+    local_socket control;
+    boost::asio::posix::stream_descriptor wake;
+    int peer_wake;
+
+    void *base;
+    std::size_t length;
+    std::size_t capacity;
+    ShmLayout *layout;
+    ShmFlags &me;
+    ShmFlags &peer;
+    ByteRing inbox;
+    ByteRing outbox;
+    std::string remote;
+
+    bool closed = false;
+    bool peer_gone = false;
+    bool waiting = false;
+
+    boost::asio::mutable_buffer read_buffer;
+    Transport::Handler read_handler;
+    Transport::ConstBuffers write_buffers; // the writer's array, kept valid until completion
+    std::size_t write_index = 0;
+    std::size_t write_offset = 0;
+    std::size_t written = 0;
+    Transport::Handler write_handler;
+};
+
+static void complete(const boost::asio::any_io_executor &ex, Transport::Handler &handler, HandlerMemory &memory,
+                     error_code ec, std::size_t n)
+{
+    post_with_memory(ex, memory, [h = std::move(handler), ec, n]() mutable
+                     { h(ec, n); });
+    handler = nullptr;
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::dial(local_socket control, std::string remote, std::size_t capacity)
+{
+    capacity = round_up_pow2(std::max<std::size_t>(capacity, 4096));
+    std::size_t length = sizeof(ShmLayout) + 2 * capacity;
+
+    UniqueFd segment(::memfd_create("relay-shm", MFD_CLOEXEC));
+    if (segment.get() < 0)
+        throw sys_error("memfd_create");
+    if (::ftruncate(segment.get(), static_cast<off_t>(length)) < 0)
+        throw sys_error("ftruncate");
+
+    UniqueFd own_wake(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    UniqueFd peer_wake(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    if (own_wake.get() < 0 || peer_wake.get() < 0)
+        throw sys_error("eventfd");
+
+    void *base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, segment.get(), 0);
+    if (base == MAP_FAILED)
+        throw sys_error("mmap");
+    auto *layout = new (base) ShmLayout();
+    layout->capacity = capacity;
+
+    try
+    {
+        send_preamble(control, LocalLink::Shm, {segment.get(), own_wake.get(), peer_wake.get()});
+    }
+    catch (...)
+    {
+        ::munmap(base, length);
+        throw;
+    }
+
+    auto state = std::make_shared<State>(std::move(control), base, length, capacity, 0, own_wake.release(),
+                                         peer_wake.release(), std::move(remote));
+    return std::unique_ptr<ShmTransport>(new ShmTransport(std::move(state)));
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::attach(local_socket control, std::vector<int> fds, std::string remote)
+{
+    std::vector<std::unique_ptr<UniqueFd>> owned;
+    for (int fd : fds)
+        owned.push_back(std::make_unique<UniqueFd>(fd));
+    if (owned.size() != 3)
+        throw std::runtime_error("shm transport: expected 3 descriptors, got " + std::to_string(fds.size()));
+
+    struct stat st;
+    if (::fstat(owned[0]->get(), &st) < 0)
+        throw sys_error("fstat");
+    auto length = static_cast<std::size_t>(st.st_size);
+    if (length < sizeof(ShmLayout))
+        throw std::runtime_error("shm transport: segment too small");
+
+    void *base = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, owned[0]->get(), 0);
+    if (base == MAP_FAILED)
+        throw sys_error("mmap");
+
+    // The segment comes from another process: check it before trusting it,
+    // bounding capacity before anything multiplies it
+    auto *layout = static_cast<ShmLayout *>(base);
+    uint64_t capacity = layout->capacity;
+    if (layout->magic != kShmMagic || capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        capacity > (length - sizeof(ShmLayout)) / 2 || length != sizeof(ShmLayout) + 2 * capacity)
+    {
+        ::munmap(base, length);
+        throw std::runtime_error("shm transport: malformed segment");
+    }
+
+    // fds[1] wakes the dialer, fds[2] is ours
+    auto state = std::make_shared<State>(std::move(control), base, length, capacity, 1, owned[2]->release(),
+                                         owned[1]->release(), std::move(remote));
+    return std::unique_ptr<ShmTransport>(new ShmTransport(std::move(state)));
+}
+
+ShmTransport::ShmTransport(std::shared_ptr<State> state)
+    : state_(std::move(state))
+{
+    watch_(state_);
+}
+
+ShmTransport::~ShmTransport()
+{
+    close();
+}
+
+void ShmTransport::async_read_some(boost::asio::mutable_buffer buffer, Handler handler)
+{
+    state_->read_buffer = buffer;
+    state_->read_handler = std::move(handler);
+    if (buffer.size() == 0)
+    {
+        complete(get_executor(), state_->read_handler, state_->read_done, {}, 0);
+        return;
+    }
+    try_read_(state_);
+}
+
+void ShmTransport::async_write(ConstBuffers buffers, Handler handler)
+{
+    State &s = *state_;
+    s.write_buffers = buffers;
+    s.write_index = 0;
+    s.write_offset = 0;
+    s.written = 0;
+    s.write_handler = std::move(handler);
+    try_write_(state_);
+}
+
+void ShmTransport::try_read_(const std::shared_ptr<State> &state)
+{
+    State &s = *state;
+    if (!s.read_handler)
+        return;
+
+    auto ex = s.control.get_executor();
+    for (;;)
+    {
+        if (s.closed)
+        {
+            complete(ex, s.read_handler, s.read_done, boost::asio::error::operation_aborted, 0);
+            return;
+        }
+
+        std::size_t n = s.inbox.read(static_cast<uint8_t *>(s.read_buffer.data()), s.read_buffer.size());
+        if (n > 0)
+        {
+            complete(ex, s.read_handler, s.read_done, {}, n);
+            // Room freed up for a writer waiting on it
+            s.notify(s.peer.write_parked);
+            return;
+        }
+        if (s.peer_gone || s.peer.closed.load())
+        {
+            complete(ex, s.read_handler, s.read_done, boost::asio::error::eof, 0);
+            return;
+        }
+
+        s.me.read_parked.store(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // Still nothing, or the writer already claimed the wakeup: its
+        // eventfd write is on the way
+        if ((s.inbox.empty() && !s.peer.closed.load()) || !s.me.read_parked.exchange(0))
+        {
+            wait_(state);
+            return;
+        }
+    }
+}
+
+void ShmTransport::try_write_(const std::shared_ptr<State> &state)
+{
+    State &s = *state;
+    if (!s.write_handler)
+        return;
+
+    auto ex = s.control.get_executor();
+    for (;;)
+    {
+        if (s.closed)
+        {
+            complete(ex, s.write_handler, s.write_done, boost::asio::error::operation_aborted, s.written);
+            return;
+        }
+        if (s.peer_gone || s.peer.closed.load())
+        {
+            complete(ex, s.write_handler, s.write_done, boost::asio::error::broken_pipe, s.written);
+            return;
+        }
+
+        bool moved = false;
+        while (s.write_index < s.write_buffers.size())
+        {
+            const auto &b = s.write_buffers[s.write_index];
+            std::size_t n = s.outbox.write(static_cast<const uint8_t *>(b.data()) + s.write_offset,
+                                           b.size() - s.write_offset);
+            s.written += n;
+            s.write_offset += n;
+            moved |= n > 0;
+            if (s.write_offset < b.size())
+                break;
+            ++s.write_index;
+            s.write_offset = 0;
+        }
+
+        if (moved)
+            s.notify(s.peer.read_parked);
+
+        if (s.write_index == s.write_buffers.size())
+        {
+            complete(ex, s.write_handler, s.write_done, {}, s.written);
+            return;
+        }
+
+        s.me.write_parked.store(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if ((s.outbox.full() && !s.peer.closed.load()) || !s.me.write_parked.exchange(0))
+        {
+            wait_(state);
+            return;
+        }
+    }
+}
+
+void ShmTransport::wait_(const std::shared_ptr<State> &state)
+{
+    if (state->waiting)
+        return;
+    state->waiting = true;
+    state->wake.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                           bind_memory(state->wait_memory, [state](error_code ec)
+                                       {
+                                           state->waiting = false;
+                                           if (ec || state->closed)
+                                               return;
+                                           uint64_t count;
+                                           ssize_t ignored = ::read(state->wake.native_handle(), &count, sizeof(count));
+                                           (void)ignored;
+                                           try_read_(state);
+                                           try_write_(state);
+                                       }));
+}
+
+void ShmTransport::watch_(const std::shared_ptr<State> &state)
+{
+    // Nothing is sent on the socket after the preamble, so readable means
+    // hung up: the peer closed or its process died
+    state->control.async_wait(local_socket::wait_read,
+                              [state](error_code ec)
+                              {
+                                  if (ec || state->closed)
+                                      return;
+                                  state->peer_gone = true;
+                                  try_read_(state);
+                                  try_write_(state);
+                              });
+}
+
+void ShmTransport::close()
+{
+    State &s = *state_;
+    if (s.closed)
+        return;
+    s.closed = true;
+
+    // The peer's read sees end of stream, its write a broken pipe
+    s.me.closed.store(1);
+    s.notify(s.peer.read_parked);
+    s.notify(s.peer.write_parked);
+
+    error_code ignored;
+    s.wake.close(ignored);
+    s.control.close(ignored);
+
+    // Our own pending operations are aborted
+    s.me.read_parked.store(0);
+    s.me.write_parked.store(0);
+    try_read_(state_);
+    try_write_(state_);
+}
+
+bool ShmTransport::is_open() const
+{
+    return !state_->closed;
+}
+
+boost::asio::any_io_executor ShmTransport::get_executor()
+{
+    return state_->control.get_executor();
+}
+
+std::string ShmTransport::remote() const
+{
+    return state_->remote;
+}
@@ -0,0 +1,244 @@
+#include "core/socket_tuning.hpp"
+#include "core/logger.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using boost::system::error_code;
+
+// Int-valued SettableSocketOption for options asio has no public type for
+template <int Level, int Name>
+class IntOption
+{
+public:
+    explicit IntOption(int value) : value_(value) {}
+
+    template <typename Protocol>
+    int level(const Protocol &) const { return Level; }
+    template <typename Protocol>
+    int name(const Protocol &) const { return Name; }
+    template <typename Protocol>
+    const int *data(const Protocol &) const { return &value_; }
+    template <typename Protocol>
+    std::size_t size(const Protocol &) const { return sizeof(value_); }
+
+private:
+    int value_;
+};
+using busy_poll = IntOption<SOL_SOCKET, SO_BUSY_POLL>;
+using reuse_port = IntOption<SOL_SOCKET, SO_REUSEPORT>;
+
+static constexpr int kMaxNumaNodes = 1024;
+
+static unsigned parse_number(const std::string &token, const std::string &text)
+{
+    std::size_t used = 0;
+    unsigned long n = 0;
+    try
+    {
+        n = std::stoul(text, &used);
+    }
+    catch (const std::exception &)
+    {
+    }
+    if (text.empty() || used != text.size() || n > INT32_MAX)
+        throw std::invalid_argument("bad number in tuning option '" + token + "'");
+    return static_cast<unsigned>(n);
+}
+
+// "N" or "A-B", appended to cpus
+static void parse_cpu_range(const std::string &token, const std::string &text, std::vector<unsigned> &cpus)
+{
+    auto dash = text.find('-');
+    unsigned first = parse_number(token, text.substr(0, dash));
+    unsigned last = dash == std::string::npos ? first : parse_number(token, text.substr(dash + 1));
+    if (last < first || last >= CPU_SETSIZE)
+        throw std::invalid_argument("bad CPU range in tuning option '" + token + "'");
+    for (unsigned cpu = first; cpu <= last; ++cpu)
+        cpus.push_back(cpu);
+}
+
+SocketTuning SocketTuning::parse(const std::string &spec)
+{
+    SocketTuning t;
+    if (spec.empty() || spec == "default")
+        return t;
+
+    std::istringstream in(spec);
+    std::string token;
+    while (std::getline(in, token, ','))
+    {
+        auto eq = token.find('=');
+        std::string key = token.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : token.substr(eq + 1);
+        bool flag = eq == std::string::npos;
+
+        if (key == "nodelay" && flag)
+            t.no_delay = true;
+        else if (key == "nagle" && flag)
+            t.no_delay = false;
+        else if (key == "reuseport" && flag)
+            t.reuse_port = true;
+        else if (key == "sndbuf" && !flag)
+            t.send_buffer = static_cast<int>(parse_number(token, value));
+        else if (key == "rcvbuf" && !flag)
+            t.receive_buffer = static_cast<int>(parse_number(token, value));
+        else if (key == "busy_poll" && !flag)
+            t.busy_poll_us = static_cast<int>(parse_number(token, value));
+        else if (key == "cpu" && !flag)
+            parse_cpu_range(token, value, t.cpus);
+        else if (key == "numa" && !flag)
+        {
+            t.numa_node = static_cast<int>(parse_number(token, value));
+            if (t.numa_node >= kMaxNumaNodes)
+                throw std::invalid_argument("bad NUMA node in tuning option '" + token + "'");
+        }
+        else
+            throw std::invalid_argument("unknown tuning option '" + token + "'");
+    }
+    return t;
+}
+
+std::string SocketTuning::describe() const
+{
+    std::vector<std::string> parts;
+    if (!no_delay)
+        parts.push_back("nagle");
+    if (send_buffer)
+        parts.push_back("sndbuf=" + std::to_string(send_buffer));
+    if (receive_buffer)
+        parts.push_back("rcvbuf=" + std::to_string(receive_buffer));
+    if (busy_poll_us)
+        parts.push_back("busy_poll=" + std::to_string(busy_poll_us));
+    if (reuse_port)
+        parts.push_back("reuseport");
+    // Consecutive CPUs collapse into ranges
+    for (std::size_t i = 0; i < cpus.size();)
+    {
+        std::size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            ++j;
+        parts.push_back("cpu=" + std::to_string(cpus[i]) +
+                        (j > i ? "-" + std::to_string(cpus[j]) : ""));
+        i = j + 1;
+    }
+    if (numa_node >= 0)
+        parts.push_back("numa=" + std::to_string(numa_node));
+
+    if (parts.empty())
+        return "default";
+    std::string out = parts[0];
+    for (std::size_t i = 1; i < parts.size(); ++i)
+        out += "," + parts[i];
+    return out;
+}
+
+enum Option
+{
+    NoDelay,
+    SendBuffer,
+    ReceiveBuffer,
+    BusyPoll,
+    ReusePort,
+    kOptionCount
+};
+static const char *const kOptionNames[kOptionCount] = {"TCP_NODELAY", "SO_SNDBUF", "SO_RCVBUF", "SO_BUSY_POLL",
+                                                       "SO_REUSEPORT"};
+static std::atomic<bool> warned[kOptionCount];
+
+// Once per option, not once per connection
+static void report(Option option, const error_code &ec)
+{
+    if (ec && !warned[option].exchange(true))
+        LOG_WARN("socket tuning: " << kOptionNames[option] << " not applied: " << ec.message());
+}
+
+template <typename Socket>
+static void apply_buffers(Socket &socket, const SocketTuning &tuning)
+{
+    error_code ec;
+    if (tuning.send_buffer)
+        report(SendBuffer, socket.set_option(boost::asio::socket_base::send_buffer_size(tuning.send_buffer), ec));
+    if (tuning.receive_buffer)
+        report(ReceiveBuffer,
+               socket.set_option(boost::asio::socket_base::receive_buffer_size(tuning.receive_buffer), ec));
+}
+
+void apply_tuning(tcp::socket &socket, const SocketTuning &tuning)
+{
+    error_code ec;
+    if (tuning.no_delay)
+        report(NoDelay, socket.set_option(tcp::no_delay(true), ec));
+    if (tuning.busy_poll_us)
+        report(BusyPoll, socket.set_option(busy_poll(tuning.busy_poll_us), ec));
+    apply_buffers(socket, tuning);
+}
+
+void apply_tuning(tcp::acceptor &acceptor, const SocketTuning &tuning)
+{
+    error_code ec;
+    if (tuning.reuse_port)
+        report(ReusePort, acceptor.set_option(reuse_port(1), ec));
+    apply_buffers(acceptor, tuning);
+}
+
+// CPUs of a NUMA node, from sysfs; empty when the node does not exist
+static std::vector<unsigned> numa_cpus(int node)
+{
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    std::vector<unsigned> cpus;
+    if (!std::getline(in, list))
+        return cpus;
+
+    std::istringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ','))
+        if (!range.empty())
+            parse_cpu_range(range, range, cpus);
+    return cpus;
+}
+
+void place_thread(const SocketTuning &tuning, std::size_t index)
+{
+    if (!tuning.places_threads())
+        return;
+
+    std::vector<unsigned> cpus = tuning.cpus;
+    if (cpus.empty())
+    {
+        cpus = numa_cpus(tuning.numa_node);
+        if (cpus.empty())
+            LOG_WARN("socket tuning: NUMA node " << tuning.numa_node << " not found, thread not pinned");
+    }
+    if (!cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[index % cpus.size()], &set);
+        if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+            LOG_WARN("socket tuning: cannot pin io thread to CPU " << cpus[index % cpus.size()] << ": "
+                                                                   << std::strerror(err));
+    }
+
+    // Blocks first touched by this thread (buffer pools, rings) come from
+    // the preferred node while it has memory
+    if (tuning.numa_node >= 0)
+    {
+        constexpr std::size_t bits = 8 * sizeof(unsigned long);
+        unsigned long mask[kMaxNumaNodes / bits] = {};
+        mask[tuning.numa_node / bits] |= 1ul << (tuning.numa_node % bits);
+        if (::syscall(__NR_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) < 0)
+            LOG_WARN("socket tuning: NUMA node " << tuning.numa_node << " memory policy: " << std::strerror(errno));
+    }
+}
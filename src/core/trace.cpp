@@ -0,0 +1,235 @@
+#include "core/trace.hpp"
+#include "core/wire.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <tuple>
+
+// Single-writer ring; the owning thread publishes `head` after each event
+struct Tracer::Ring
+{
+    static constexpr std::size_t capacity = 1 << 16; // power of two
+
+    std::vector<TraceEvent> events = std::vector<TraceEvent>(capacity);
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> start{0}; // moved up by clear()
+};
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::set_sample_rate(uint32_t one_in)
+{
+    sample_rate_.store(one_in, std::memory_order_relaxed);
+}
+
+bool Tracer::sample()
+{
+    uint32_t rate = sample_rate();
+    if (rate == 0)
+        return false;
+
+    thread_local uint32_t counter = 0;
+    if (++counter < rate)
+        return false;
+    counter = 0;
+    return true;
+}
+
+uint64_t Tracer::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+uint64_t Tracer::trace_id_of(const MessageHeader &header, Span<const uint8_t> body)
+{
+    if (!(header.flags & kFlagTraced) || body.size() < sizeof(TraceExtension))
+        return 0;
+
+    return decode_trace_extension(body.data()).trace_id;
+}
+
+Tracer::Ring &Tracer::local_ring_()
+{
+    // The tracer lives until exit, so the cached pointer never dangles; the
+    // registry keeps rings of finished threads around for export
+    thread_local Ring *ring = nullptr;
+    if (!ring)
+    {
+        auto owned = std::make_shared<Ring>();
+        ring = owned.get();
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        rings_.push_back(std::move(owned));
+    }
+    return *ring;
+}
+
+void Tracer::record(TraceStage stage, uint64_t trace_id, uint64_t node_id, uint32_t conn_id, uint64_t ts_ns)
+{
+    Ring &ring = local_ring_();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    ring.events[head & (Ring::capacity - 1)] =
+        TraceEvent{ts_ns ? ts_ns : now_ns(), trace_id, node_id, conn_id, stage};
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+std::vector<TraceEvent> Tracer::snapshot() const
+{
+    std::vector<TraceEvent> out;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const auto &ring : rings_)
+        {
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t first = std::max(ring->start.load(std::memory_order_relaxed),
+                                      head > Ring::capacity ? head - Ring::capacity : 0);
+            for (uint64_t i = first; i < head; ++i)
+                out.push_back(ring->events[i & (Ring::capacity - 1)]);
+        }
+    }
+
+    std::sort(out.begin(), out.end(), [](const TraceEvent &a, const TraceEvent &b)
+              { return a.ts_ns < b.ts_ns; });
+    return out;
+}
+
+void Tracer::clear()
+{
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    for (auto &ring : rings_)
+        ring->start.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+static const char *stage_name(TraceStage stage)
+{
+    switch (stage)
+    {
+    case TraceStage::Originate:
+        return "originate";
+    case TraceStage::ReadComplete:
+        return "read";
+    case TraceStage::Deliver:
+        return "deliver";
+    case TraceStage::Forward:
+        return "forward";
+    case TraceStage::Duplicate:
+        return "duplicate";
+    case TraceStage::Expired:
+        return "expired";
+    case TraceStage::Enqueue:
+        return "enqueue";
+    case TraceStage::WriteComplete:
+        return "write";
+    }
+    return "?";
+}
+
+void Tracer::write_chrome_json(std::ostream &out, const std::vector<TraceEvent> &events)
+{
+    bool first = true;
+    auto emit = [&out, &first](const std::string &event)
+    {
+        out << (first ? "\n  " : ",\n  ") << event;
+        first = false;
+    };
+    auto us = [](uint64_t ns)
+    {
+        return std::to_string(ns / 1000) + "." + std::to_string(ns % 1000 + 1000).substr(1);
+    };
+    auto id = [](uint64_t trace_id)
+    {
+        return "\"trace_id\":\"" + std::to_string(trace_id) + "\"";
+    };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    std::map<uint64_t, std::vector<uint32_t>> lanes; // node -> connections seen
+    std::map<std::pair<uint64_t, uint64_t>, uint64_t> read_at;               // (trace, node)
+    std::map<std::tuple<uint64_t, uint64_t, uint32_t>, uint64_t> queued_at; // (trace, node, conn)
+    std::map<uint64_t, std::pair<uint64_t, uint64_t>> origin;                // trace -> (node, ts)
+    std::map<uint64_t, uint64_t> delivered;                                  // trace -> ts
+
+    for (const auto &e : events)
+    {
+        std::string where = "\"pid\":" + std::to_string(e.node_id) + ",\"tid\":" + std::to_string(e.conn_id);
+        auto &conns = lanes[e.node_id];
+        if (e.conn_id && std::find(conns.begin(), conns.end(), e.conn_id) == conns.end())
+            conns.push_back(e.conn_id);
+
+        switch (e.stage)
+        {
+        case TraceStage::Originate:
+            origin.emplace(e.trace_id, std::make_pair(e.node_id, e.ts_ns));
+            emit("{\"name\":\"originate\",\"ph\":\"i\",\"s\":\"t\"," + where + ",\"ts\":" + us(e.ts_ns) +
+                 ",\"args\":{" + id(e.trace_id) + "}}");
+            break;
+        case TraceStage::ReadComplete:
+            read_at[{e.trace_id, e.node_id}] = e.ts_ns;
+            break;
+        case TraceStage::Deliver:
+        case TraceStage::Forward:
+        case TraceStage::Duplicate:
+        case TraceStage::Expired:
+        {
+            if (e.stage == TraceStage::Deliver)
+                delivered[e.trace_id] = e.ts_ns;
+
+            // Time from the read returning to the routing decision
+            auto it = read_at.find({e.trace_id, e.node_id});
+            if (it == read_at.end())
+                break;
+            emit(std::string("{\"name\":\"") + stage_name(e.stage) + "\",\"ph\":\"X\"," + where +
+                 ",\"ts\":" + us(it->second) + ",\"dur\":" + us(e.ts_ns - it->second) +
+                 ",\"args\":{" + id(e.trace_id) + "}}");
+            read_at.erase(it);
+            break;
+        }
+        case TraceStage::Enqueue:
+            queued_at[{e.trace_id, e.node_id, e.conn_id}] = e.ts_ns;
+            break;
+        case TraceStage::WriteComplete:
+        {
+            // Write queue wait plus the write itself
+            auto it = queued_at.find({e.trace_id, e.node_id, e.conn_id});
+            if (it == queued_at.end())
+                break;
+            emit("{\"name\":\"queue+write\",\"ph\":\"X\"," + where + ",\"ts\":" + us(it->second) +
+                 ",\"dur\":" + us(e.ts_ns - it->second) + ",\"args\":{" + id(e.trace_id) + "}}");
+            queued_at.erase(it);
+            break;
+        }
+        }
+    }
+
+    // End to end, as an async span on the source node
+    for (const auto &[trace_id, end] : delivered)
+    {
+        auto it = origin.find(trace_id);
+        if (it == origin.end())
+            continue;
+        auto [node, start] = it->second;
+        std::string common = "\"name\":\"message\",\"cat\":\"message\",\"id\":\"" + std::to_string(trace_id) +
+                             "\",\"pid\":" + std::to_string(node) + ",\"tid\":0";
+        emit("{" + common + ",\"ph\":\"b\",\"ts\":" + us(start) + "}");
+        emit("{" + common + ",\"ph\":\"e\",\"ts\":" + us(end) + "}");
+    }
+
+    for (const auto &[node, conns] : lanes)
+    {
+        std::string pid = "\"pid\":" + std::to_string(node);
+        emit("{\"name\":\"process_name\",\"ph\":\"M\"," + pid + ",\"args\":{\"name\":\"node " +
+             std::to_string(node) + "\"}}");
+        emit("{\"name\":\"thread_name\",\"ph\":\"M\"," + pid + ",\"tid\":0,\"args\":{\"name\":\"router\"}}");
+        for (uint32_t conn : conns)
+            emit("{\"name\":\"thread_name\",\"ph\":\"M\"," + pid + ",\"tid\":" + std::to_string(conn) +
+                 ",\"args\":{\"name\":\"conn " + std::to_string(conn) + "\"}}");
+    }
+
+    out << "\n]}\n";
+}
@@ -0,0 +1,79 @@
+#include "core/transport.hpp"
+#include "core/uring_transport.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#ifdef RELAY_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using boost::system::error_code;
+
+std::string describe_remote(const tcp::socket &socket)
+{
+    error_code ec;
+    auto remote = socket.remote_endpoint(ec);
+    return ec ? "?" : remote.address().to_string() + ":" + std::to_string(remote.port());
+}
+
+#ifdef RELAY_IO_URING
+static bool uring_supported()
+{
+    const char *forced = std::getenv("RELAY_IO_BACKEND");
+    if (forced && std::strcmp(forced, "epoll") == 0)
+        return false;
+
+    // SINGLE_ISSUER came with multishot receive in 6.0; older kernels
+    // refuse the flag
+    io_uring_params p{};
+    p.flags = IORING_SETUP_SINGLE_ISSUER;
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, 2, &p));
+    if (fd < 0)
+        return false;
+    ::close(fd);
+    return true;
+}
+#endif
+
+const char *tcp_backend()
+{
+#ifdef RELAY_IO_URING
+    static const bool uring = uring_supported();
+    return uring ? "io_uring" : "epoll";
+#else
+    return "epoll";
+#endif
+}
+
+std::unique_ptr<Transport> make_tcp_transport(tcp::socket socket)
+{
+#ifdef RELAY_IO_URING
+    if (std::strcmp(tcp_backend(), "io_uring") == 0)
+        if (auto transport = UringTransport::make(socket))
+            return transport;
+#endif
+    return std::make_unique<TcpTransport>(std::move(socket));
+}
+
+TcpTransport::TcpTransport(tcp::socket socket)
+    : socket_(std::move(socket)), remote_(describe_remote(socket_))
+{
+}
+
+void TcpTransport::async_read_some(boost::asio::mutable_buffer buffer, Handler handler)
+{
+    socket_.async_read_some(buffer, bind_memory(read_memory_, std::move(handler)));
+}
+
+void TcpTransport::async_write(ConstBuffers buffers, Handler handler)
+{
+    boost::asio::async_write(socket_, buffers, bind_memory(write_memory_, std::move(handler)));
+}
+
+void TcpTransport::close()
+{
+    error_code ignored;
+    socket_.close(ignored);
+}
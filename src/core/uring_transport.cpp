@@ -0,0 +1,686 @@
+#ifdef RELAY_IO_URING
+#include "core/uring_transport.hpp"
+#include "core/logger.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <optional>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <unordered_set>
+
+using boost::system::error_code;
+
+static constexpr unsigned kRingEntries = 256;
+// Receive buffers shared by the connections of one io_context
+static constexpr unsigned kRecvBuffers = 128; // power of two
+static constexpr std::size_t kRecvBufferSize = 8192;
+static constexpr uint16_t kBufferGroup = 0;
+
+// Low bits of user_data name the operation, the rest is the State
+static constexpr uint64_t kOpRecv = 1;
+static constexpr uint64_t kOpSend = 2;
+static constexpr uint64_t kOpMask = 3;
+
+static int uring_setup(unsigned entries, io_uring_params *p)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+struct UringTransport::State : std::enable_shared_from_this<State>
+{
+    struct Chunk
+    {
+        uint16_t bid;
+        uint32_t offset;
+        uint32_t len;
+    };
+
+    ~State();
+
+    int fd = -1;
+    boost::asio::any_io_executor ex;
+    UringService *service = nullptr; // cleared if the service shuts down first
+    std::string remote;
+    bool closed = false;
+
+    // Held while the kernel has operations of ours
+    unsigned inflight = 0;
+    std::shared_ptr<State> keepalive;
+
+    // Received into ring buffers, not yet handed out
+    bool recv_armed = false;
+    bool starved = false; // waiting for a receive buffer to come back
+    std::deque<Chunk> ready;
+    error_code read_error;
+    boost::asio::mutable_buffer read_buffer;
+    Handler read_handler;
+
+    std::vector<iovec> iov;
+    std::size_t iov_index = 0;
+    msghdr msg{};
+    std::size_t written = 0;
+    Handler write_handler;
+
+    HandlerMemory read_done;
+    HandlerMemory write_done;
+};
+
+class UringService : public boost::asio::execution_context::service
+{
+public:
+    static boost::asio::execution_context::id id;
+
+    explicit UringService(boost::asio::execution_context &context) : service(context) {}
+    ~UringService() override { shutdown(); }
+
+    // Sets the ring up on first use; false when io_uring is unavailable
+    bool start(const boost::asio::any_io_executor &ex);
+
+    void adopt(UringTransport::State *state) { states_.insert(state); }
+    void forget(UringTransport::State *state) { states_.erase(state); }
+
+    // Next submission entry, tagged for `state`; sent with the batch.
+    // nullptr if the submission queue stays full.
+    io_uring_sqe *get_sqe(UringTransport::State &state, uint64_t op);
+
+    uint8_t *buffer(uint16_t bid) { return buffers_ + bid * kRecvBufferSize; }
+    // Hands a receive buffer back to the kernel
+    void recycle(uint16_t bid);
+    // A completion carried one of the kernel's buffers
+    void took_buffer() { --kernel_buffers_; }
+    // The connection ran out of receive buffers; retried once some return
+    void starve(const std::shared_ptr<UringTransport::State> &state);
+
+private:
+    void shutdown() override;
+    void wait_();
+    void reap_();
+    void flush_();
+    void rearm_starved_();
+
+    bool started_ = false;
+    bool ok_ = false;
+    bool stopped_ = false;
+    // Before everything whose operations they hold, so they are freed last
+    HandlerMemory flush_memory_;
+    HandlerMemory wait_memory_;
+    boost::asio::any_io_executor ex_;
+
+    int ring_fd_ = -1;
+    void *sq_ptr_ = MAP_FAILED;
+    std::size_t sq_len_ = 0;
+    void *cq_ptr_ = MAP_FAILED;
+    std::size_t cq_len_ = 0;
+    io_uring_sqe *sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+    std::size_t sqes_len_ = 0;
+
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_flags_ = nullptr;
+    unsigned *sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    io_uring_cqe *cqes_ = nullptr;
+    unsigned cq_mask_ = 0;
+
+    // Queued locally, published and submitted by flush_()
+    unsigned local_tail_ = 0;
+    unsigned submitted_ = 0;
+    bool flush_scheduled_ = false;
+
+    io_uring_buf_ring *buf_ring_ = static_cast<io_uring_buf_ring *>(MAP_FAILED);
+    uint8_t *buffers_ = static_cast<uint8_t *>(MAP_FAILED);
+    uint16_t buf_tail_ = 0;
+    unsigned kernel_buffers_ = 0;
+    std::vector<std::weak_ptr<UringTransport::State>> starved_;
+    bool rearm_scheduled_ = false;
+
+    std::optional<boost::asio::posix::stream_descriptor> wake_;
+    std::unordered_set<UringTransport::State *> states_;
+};
+
+boost::asio::execution_context::id UringService::id;
+
+bool UringService::start(const boost::asio::any_io_executor &ex)
+{
+    if (started_)
+        return ok_;
+    started_ = true;
+    ex_ = ex;
+
+    io_uring_params p{};
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    // Multishot receives produce many completions per submission
+    p.cq_entries = kRingEntries * 8;
+    ring_fd_ = uring_setup(kRingEntries, &p);
+    if (ring_fd_ < 0)
+    {
+        LOG_WARN("io_uring unavailable (" << std::strerror(errno) << "), using epoll");
+        return false;
+    }
+
+    sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+        sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+    sq_ptr_ = ::mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                     IORING_OFF_SQ_RING);
+    cq_ptr_ = single ? sq_ptr_
+                     : ::mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                              IORING_OFF_CQ_RING);
+    sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(::mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+
+    std::size_t buf_ring_len = kRecvBuffers * sizeof(io_uring_buf);
+    buf_ring_ = static_cast<io_uring_buf_ring *>(::mmap(nullptr, buf_ring_len, PROT_READ | PROT_WRITE,
+                                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    buffers_ = static_cast<uint8_t *>(::mmap(nullptr, kRecvBuffers * kRecvBufferSize, PROT_READ | PROT_WRITE,
+                                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (sq_ptr_ == MAP_FAILED || cq_ptr_ == MAP_FAILED || sqes_ == MAP_FAILED || buf_ring_ == MAP_FAILED ||
+        buffers_ == MAP_FAILED)
+    {
+        LOG_WARN("io_uring mmap failed (" << std::strerror(errno) << "), using epoll");
+        shutdown();
+        return false;
+    }
+
+    auto *sq = static_cast<uint8_t *>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sq_flags_ = reinterpret_cast<unsigned *>(sq + p.sq_off.flags);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sq_entries_ = p.sq_entries;
+    local_tail_ = submitted_ = *sq_tail_;
+
+    auto *cq = static_cast<uint8_t *>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = kRecvBuffers;
+    reg.bgid = kBufferGroup;
+    if (uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        LOG_WARN("io_uring buffer ring unsupported (" << std::strerror(errno) << "), using epoll");
+        shutdown();
+        return false;
+    }
+    for (unsigned i = 0; i < kRecvBuffers; ++i)
+        recycle(static_cast<uint16_t>(i));
+
+    int efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd < 0 || uring_register(ring_fd_, IORING_REGISTER_EVENTFD, &efd, 1) < 0)
+    {
+        LOG_WARN("io_uring eventfd failed (" << std::strerror(errno) << "), using epoll");
+        if (efd >= 0)
+            ::close(efd);
+        shutdown();
+        return false;
+    }
+    wake_.emplace(ex_, efd);
+    wait_();
+
+    ok_ = true;
+    LOG_DEBUG("io_uring backend: " << sq_entries_ << " sq / " << p.cq_entries << " cq entries, " << kRecvBuffers
+                                   << " x " << kRecvBufferSize << " byte receive buffers");
+    return true;
+}
+
+void UringService::shutdown()
+{
+    if (stopped_)
+        return;
+    stopped_ = true;
+
+    // Operations still in the kernel die with the ring; drop what they held
+    std::vector<std::shared_ptr<UringTransport::State>> held;
+    for (auto *state : states_)
+    {
+        state->service = nullptr;
+        held.push_back(std::move(state->keepalive));
+    }
+    states_.clear();
+    held.clear();
+
+    wake_.reset();
+    if (sqes_ != MAP_FAILED)
+        ::munmap(sqes_, sqes_len_);
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+        ::munmap(cq_ptr_, cq_len_);
+    if (sq_ptr_ != MAP_FAILED)
+        ::munmap(sq_ptr_, sq_len_);
+    if (buf_ring_ != MAP_FAILED)
+        ::munmap(buf_ring_, kRecvBuffers * sizeof(io_uring_buf));
+    if (buffers_ != MAP_FAILED)
+        ::munmap(buffers_, kRecvBuffers * kRecvBufferSize);
+    if (ring_fd_ >= 0)
+        ::close(ring_fd_);
+    ring_fd_ = -1;
+}
+
+io_uring_sqe *UringService::get_sqe(UringTransport::State &state, uint64_t op)
+{
+    if (local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_)
+    {
+        flush_();
+        if (local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == sq_entries_)
+            return nullptr;
+    }
+
+    unsigned index = local_tail_ & sq_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = reinterpret_cast<uint64_t>(&state) | op;
+    sq_array_[index] = index;
+    ++local_tail_;
+
+    if (state.inflight++ == 0)
+        state.keepalive = state.shared_from_this();
+
+    // Everything queued until the handlers of this turn are done goes out
+    // in one io_uring_enter
+    if (!flush_scheduled_)
+    {
+        flush_scheduled_ = true;
+        post_with_memory(ex_, flush_memory_, [this]
+                         {
+            flush_scheduled_ = false;
+            if (!stopped_)
+                flush_(); });
+    }
+    return sqe;
+}
+
+void UringService::flush_()
+{
+    unsigned pending = local_tail_ - submitted_;
+    if (pending == 0)
+        return;
+    __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+
+    int n;
+    do
+        n = uring_enter(ring_fd_, pending, 0, 0);
+    while (n < 0 && errno == EINTR);
+    if (n > 0)
+        submitted_ += static_cast<unsigned>(n);
+    else if (n < 0)
+        LOG_ERROR("io_uring_enter: " << std::strerror(errno));
+}
+
+void UringService::recycle(uint16_t bid)
+{
+    // Not buf_ring_->bufs: the uapi flexible array sits 8 bytes in when
+    // compiled as C++, while the kernel reads entries from offset 0
+    io_uring_buf &b = reinterpret_cast<io_uring_buf *>(buf_ring_)[buf_tail_ & (kRecvBuffers - 1)];
+    b.addr = reinterpret_cast<uint64_t>(buffer(bid));
+    b.len = kRecvBufferSize;
+    b.bid = bid;
+    ++buf_tail_;
+    __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+    ++kernel_buffers_;
+    rearm_starved_();
+}
+
+void UringService::starve(const std::shared_ptr<UringTransport::State> &state)
+{
+    starved_.push_back(state);
+    // Buffers may have come back between the kernel's refusal and now
+    if (kernel_buffers_ > 0)
+        rearm_starved_();
+}
+
+void UringService::rearm_starved_()
+{
+    if (starved_.empty() || rearm_scheduled_)
+        return;
+    rearm_scheduled_ = true;
+    boost::asio::post(ex_, [this]
+                      {
+        rearm_scheduled_ = false;
+        if (stopped_)
+            return;
+        auto starved = std::move(starved_);
+        starved_.clear();
+        for (auto &weak : starved)
+            if (auto state = weak.lock())
+            {
+                state->starved = false;
+                UringTransport::try_read_(state);
+            } });
+}
+
+void UringService::wait_()
+{
+    wake_->async_wait(boost::asio::posix::stream_descriptor::wait_read, bind_memory(wait_memory_, [this](error_code ec)
+                                                                                    {
+        if (ec || stopped_)
+            return;
+        uint64_t count;
+        ssize_t ignored = ::read(wake_->native_handle(), &count, sizeof(count));
+        (void)ignored;
+        reap_();
+        if (!stopped_)
+            wait_(); }));
+}
+
+void UringService::reap_()
+{
+    for (;;)
+    {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        if (head == tail)
+        {
+            // With IORING_FEAT_NODROP overflowed completions wait in the
+            // kernel until asked for
+            if (!(__atomic_load_n(sq_flags_, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW))
+                return;
+            uring_enter(ring_fd_, 0, 0, IORING_ENTER_GETEVENTS);
+            if (*cq_head_ == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+                return;
+            continue;
+        }
+
+        for (; head != tail && !stopped_; ++head)
+        {
+            io_uring_cqe cqe = cqes_[head & cq_mask_];
+            __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+
+            auto *raw = reinterpret_cast<UringTransport::State *>(cqe.user_data & ~kOpMask);
+            uint64_t op = cqe.user_data & kOpMask;
+            if (!raw)
+                continue;
+
+            std::shared_ptr<UringTransport::State> state = raw->keepalive;
+            bool last = op == kOpSend || !(cqe.flags & IORING_CQE_F_MORE);
+            if (last && --raw->inflight == 0)
+                raw->keepalive.reset();
+
+            if (op == kOpRecv)
+                UringTransport::on_recv_(state, cqe.res, cqe.flags);
+            else
+                UringTransport::on_send_(state, cqe.res);
+        }
+        if (stopped_)
+            return;
+    }
+}
+
+static void complete(const boost::asio::any_io_executor &ex, Transport::Handler &handler, HandlerMemory &memory,
+                     error_code ec, std::size_t n)
+{
+    post_with_memory(ex, memory, [h = std::move(handler), ec, n]() mutable
+                     { h(ec, n); });
+    handler = nullptr;
+}
+
+UringTransport::State::~State()
+{
+    if (service)
+    {
+        for (auto &chunk : ready)
+            service->recycle(chunk.bid);
+        service->forget(this);
+    }
+    if (fd >= 0)
+        ::close(fd);
+}
+
+std::unique_ptr<UringTransport> UringTransport::make(tcp::socket &socket)
+{
+    auto ex = socket.get_executor();
+    auto &service = boost::asio::use_service<UringService>(boost::asio::query(ex, boost::asio::execution::context));
+    if (!service.start(ex))
+        return nullptr;
+
+    auto state = std::make_shared<State>();
+    state->remote = describe_remote(socket);
+
+    // Out of the epoll reactor: from here on only the ring drives the socket
+    error_code ec;
+    int fd = socket.release(ec);
+    if (ec)
+        return nullptr;
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+    state->fd = fd;
+    state->ex = ex;
+    state->service = &service;
+    service.adopt(state.get());
+    return std::unique_ptr<UringTransport>(new UringTransport(std::move(state)));
+}
+
+UringTransport::UringTransport(std::shared_ptr<State> state)
+    : state_(std::move(state))
+{
+}
+
+UringTransport::~UringTransport()
+{
+    close();
+}
+
+void UringTransport::async_read_some(boost::asio::mutable_buffer buffer, Handler handler)
+{
+    state_->read_buffer = buffer;
+    state_->read_handler = std::move(handler);
+    try_read_(state_);
+}
+
+void UringTransport::try_read_(const std::shared_ptr<State> &state)
+{
+    State &s = *state;
+    if (!s.read_handler)
+        return;
+    if (s.closed || !s.service)
+    {
+        complete(s.ex, s.read_handler, s.read_done, boost::asio::error::operation_aborted, 0);
+        return;
+    }
+
+    if (!s.ready.empty() || s.read_buffer.size() == 0)
+    {
+        // Hand out as much as fits, across buffers
+        auto *dst = static_cast<uint8_t *>(s.read_buffer.data());
+        std::size_t n = 0;
+        while (!s.ready.empty() && n < s.read_buffer.size())
+        {
+            auto &chunk = s.ready.front();
+            std::size_t take = std::min<std::size_t>(chunk.len - chunk.offset, s.read_buffer.size() - n);
+            std::memcpy(dst + n, s.service->buffer(chunk.bid) + chunk.offset, take);
+            n += take;
+            chunk.offset += static_cast<uint32_t>(take);
+            if (chunk.offset == chunk.len)
+            {
+                s.service->recycle(chunk.bid);
+                s.ready.pop_front();
+            }
+        }
+        complete(s.ex, s.read_handler, s.read_done, {}, n);
+        return;
+    }
+    if (s.read_error)
+    {
+        complete(s.ex, s.read_handler, s.read_done, s.read_error, 0);
+        return;
+    }
+    if (s.recv_armed || s.starved)
+        return;
+
+    io_uring_sqe *sqe = s.service->get_sqe(s, kOpRecv);
+    if (!sqe)
+    {
+        complete(s.ex, s.read_handler, s.read_done, boost::asio::error::no_buffer_space, 0);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = s.fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    s.recv_armed = true;
+}
+
+void UringTransport::on_recv_(const std::shared_ptr<State> &state, int res, uint32_t flags)
+{
+    State &s = *state;
+    if (!(flags & IORING_CQE_F_MORE))
+        s.recv_armed = false;
+
+    if (flags & IORING_CQE_F_BUFFER)
+    {
+        auto bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        s.service->took_buffer();
+        if (res > 0 && !s.closed)
+            s.ready.push_back({bid, 0, static_cast<uint32_t>(res)});
+        else
+            s.service->recycle(bid);
+    }
+    if (res == -ENOBUFS)
+    {
+        s.starved = true;
+        s.service->starve(state);
+    }
+    else if (res <= 0 && !s.read_error)
+        s.read_error = res == 0 ? error_code(boost::asio::error::eof)
+                                : error_code(-res, boost::system::system_category());
+
+    try_read_(state);
+}
+
+void UringTransport::async_write(ConstBuffers buffers, Handler handler)
+{
+    State &s = *state_;
+    s.write_handler = std::move(handler);
+    // The kernel may still read iov and msg of a send cut short by close()
+    if (s.closed || !s.service)
+    {
+        complete(s.ex, s.write_handler, s.write_done, boost::asio::error::operation_aborted, 0);
+        return;
+    }
+
+    s.iov.clear();
+    for (const auto &b : buffers)
+        if (b.size() > 0)
+            s.iov.push_back({const_cast<void *>(b.data()), b.size()});
+    s.iov_index = 0;
+    s.written = 0;
+    submit_send_(state_);
+}
+
+void UringTransport::submit_send_(const std::shared_ptr<State> &state)
+{
+    State &s = *state;
+    if (s.iov_index == s.iov.size())
+    {
+        complete(s.ex, s.write_handler, s.write_done, {}, s.written);
+        return;
+    }
+
+    io_uring_sqe *sqe = s.service->get_sqe(s, kOpSend);
+    if (!sqe)
+    {
+        complete(s.ex, s.write_handler, s.write_done, boost::asio::error::no_buffer_space, s.written);
+        return;
+    }
+    s.msg = {};
+    s.msg.msg_iov = &s.iov[s.iov_index];
+    s.msg.msg_iovlen = std::min<std::size_t>(s.iov.size() - s.iov_index, IOV_MAX);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = s.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&s.msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+}
+
+void UringTransport::on_send_(const std::shared_ptr<State> &state, int res)
+{
+    State &s = *state;
+    if (!s.write_handler)
+        return; // aborted by close()
+    if (res < 0)
+    {
+        complete(s.ex, s.write_handler, s.write_done, error_code(-res, boost::system::system_category()), s.written);
+        return;
+    }
+
+    // Partial sends continue where the kernel stopped
+    auto left = static_cast<std::size_t>(res);
+    s.written += left;
+    while (left > 0 && s.iov_index < s.iov.size())
+    {
+        iovec &v = s.iov[s.iov_index];
+        if (left < v.iov_len)
+        {
+            v.iov_base = static_cast<uint8_t *>(v.iov_base) + left;
+            v.iov_len -= left;
+            break;
+        }
+        left -= v.iov_len;
+        ++s.iov_index;
+    }
+    submit_send_(state);
+}
+
+void UringTransport::close()
+{
+    State &s = *state_;
+    if (s.closed)
+        return;
+    s.closed = true;
+
+    // Ends the multishot receive and any send still in the kernel
+    ::shutdown(s.fd, SHUT_RDWR);
+
+    if (s.read_handler)
+        complete(s.ex, s.read_handler, s.read_done, boost::asio::error::operation_aborted, 0);
+    if (s.write_handler)
+        complete(s.ex, s.write_handler, s.write_done, boost::asio::error::operation_aborted, s.written);
+    if (s.service)
+        for (auto &chunk : s.ready)
+            s.service->recycle(chunk.bid);
+    s.ready.clear();
+}
+
+bool UringTransport::is_open() const
+{
+    return !state_->closed;
+}
+
+boost::asio::any_io_executor UringTransport::get_executor()
+{
+    return state_->ex;
+}
+
+std::string UringTransport::remote() const
+{
+    return state_->remote;
+}
+#endif
@@ -0,0 +1,146 @@
+#include "core/wire.hpp"
+
+#include <limits>
+
+template <typename T>
+static uint8_t *put_le(uint8_t *out, T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+        *out++ = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+    return out;
+}
+
+template <typename T>
+static T get_le(const uint8_t *in)
+{
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    return static_cast<T>(value);
+}
+
+static uint8_t *put_varint(uint8_t *out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+// Reads a varint no larger than T; advances `at`
+template <typename T>
+static WireStatus get_varint(const uint8_t *data, std::size_t n, std::size_t &at, T &value)
+{
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if (at == n)
+            return WireStatus::Incomplete;
+        uint8_t byte = data[at++];
+        // The tenth byte holds only the top bit of a 64-bit value
+        if (shift == 63 && (byte & 0x7f) > 1)
+            return WireStatus::Malformed;
+        result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            if (result > std::numeric_limits<T>::max())
+                return WireStatus::Malformed;
+            value = static_cast<T>(result);
+            return WireStatus::Ok;
+        }
+    }
+    return WireStatus::Malformed;
+}
+
+std::size_t encode_header(const MessageHeader &header, uint8_t version, uint8_t *out)
+{
+    uint8_t *p = out;
+    *p++ = version;
+    if (version == kWireFixed)
+    {
+        p = put_le<uint16_t>(p, header.type);
+        p = put_le<uint64_t>(p, header.src_node_id);
+        p = put_le<uint64_t>(p, header.dst_node_id);
+        p = put_le<uint32_t>(p, header.seq);
+        p = put_le<uint32_t>(p, header.size);
+        p = put_le<uint16_t>(p, header.ttl);
+        *p++ = header.flags;
+        return static_cast<std::size_t>(p - out);
+    }
+
+    *p++ = header.flags;
+    p = put_varint(p, header.type);
+    p = put_varint(p, header.src_node_id);
+    p = put_varint(p, header.dst_node_id);
+    p = put_varint(p, header.seq);
+    p = put_varint(p, header.size);
+    p = put_varint(p, header.ttl);
+    return static_cast<std::size_t>(p - out);
+}
+
+WireStatus decode_header(const uint8_t *data, std::size_t n, MessageHeader &header, std::size_t &header_size)
+{
+    if (n == 0)
+        return WireStatus::Incomplete;
+
+    header.version = data[0];
+    if (header.version == kWireFixed)
+    {
+        if (n < kFixedHeaderSize)
+            return WireStatus::Incomplete;
+        header.type = get_le<uint16_t>(data + 1);
+        header.src_node_id = get_le<uint64_t>(data + 3);
+        header.dst_node_id = get_le<uint64_t>(data + 11);
+        header.seq = get_le<uint32_t>(data + 19);
+        header.size = get_le<uint32_t>(data + 23);
+        header.ttl = get_le<uint16_t>(data + 27);
+        header.flags = data[29];
+        header_size = kFixedHeaderSize;
+        return WireStatus::Ok;
+    }
+    if (header.version != kWireCompact)
+        return WireStatus::Malformed;
+    if (n < 2)
+        return WireStatus::Incomplete;
+
+    // Packed fields are decoded through locals; no references to them
+    header.flags = data[1];
+    std::size_t at = 2;
+    uint16_t type = 0, ttl = 0;
+    uint64_t src = 0, dst = 0;
+    uint32_t seq = 0, size = 0;
+    WireStatus status;
+    if ((status = get_varint(data, n, at, type)) != WireStatus::Ok ||
+        (status = get_varint(data, n, at, src)) != WireStatus::Ok ||
+        (status = get_varint(data, n, at, dst)) != WireStatus::Ok ||
+        (status = get_varint(data, n, at, seq)) != WireStatus::Ok ||
+        (status = get_varint(data, n, at, size)) != WireStatus::Ok ||
+        (status = get_varint(data, n, at, ttl)) != WireStatus::Ok)
+        return status;
+
+    header.type = type;
+    header.src_node_id = src;
+    header.dst_node_id = dst;
+    header.seq = seq;
+    header.size = size;
+    header.ttl = ttl;
+    header_size = at;
+    return WireStatus::Ok;
+}
+
+void encode_trace_extension(const TraceExtension &ext, uint8_t *out)
+{
+    out = put_le<uint64_t>(out, ext.trace_id);
+    put_le<uint64_t>(out, ext.origin_ns);
+}
+
+TraceExtension decode_trace_extension(const uint8_t *in)
+{
+    TraceExtension ext;
+    ext.trace_id = get_le<uint64_t>(in);
+    ext.origin_ns = get_le<uint64_t>(in + 8);
+    return ext;
+}
@@ -1,5 +1,8 @@
 #include "ui/cli_manager.hpp"
+#include "core/logger.hpp"
+#include "core/trace.hpp"
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <algorithm>
 
@@ -7,6 +10,7 @@ CliManager::CliManager() : running_(false) {}
 
 CliManager::~CliManager()
 {
+    metrics_.reset();
     stop_all();
 }
 
@@ -33,7 +37,8 @@ void CliManager::run()
     }
 }
 
-void CliManager::add_client(uint64_t id, uint16_t port)
+void CliManager::add_client(uint64_t id, uint16_t port, const std::string &local_path,
+                            const SocketTuning &tuning)
 {
     std::lock_guard<std::mutex> lock(clients_mutex_);
 
@@ -43,13 +48,23 @@ void CliManager::add_client(uint64_t id, uint16_t port)
         return;
     }
 
+    // Pool threads are shared, so they are placed once by `pool`
+    if (pool_ && tuning.places_threads())
+    {
+        std::cout << "cpu= and numa= place io threads; with a pool give them to 'pool' instead.\n";
+        return;
+    }
+
     try
     {
         ClientInfo info;
         info.id = id;
         info.port = port;
         info.running = true;
-        info.node = std::make_unique<Node>(id, port);
+        if (pool_)
+            info.node = std::make_unique<Node>(id, port, *pool_, tuning);
+        else
+            info.node = std::make_unique<Node>(id, port, tuning);
 
         // Set custom receive handler to display messages in CLI
         info.node->set_receive_handler([](uint64_t node_id, uint64_t from_id, const std::string &message)
@@ -57,13 +72,19 @@ void CliManager::add_client(uint64_t id, uint16_t port)
             std::cout << "\n[CLIENT " << node_id << "] <<< Message from " << from_id << ": " << message << std::endl;
             std::cout << std::flush; });
 
-        // Capture raw pointer for thread - the unique_ptr in the map keeps it alive
-        Node *node_ptr = info.node.get();
-        info.thread = std::make_unique<std::thread>([node_ptr]()
-                                                    { node_ptr->run(); });
+        if (!local_path.empty())
+            info.node->listen_local(local_path);
+
+        // run() only starts the accept loop; the io thread belongs to the node or the pool
+        info.node->run();
 
         clients_[id] = std::move(info);
-        std::cout << "Client " << id << " started on port " << port << "\n";
+        std::cout << "Client " << id << " started on port " << port;
+        if (!local_path.empty())
+            std::cout << " and local://" << local_path;
+        if (tuning.describe() != "default")
+            std::cout << " (" << tuning.describe() << ")";
+        std::cout << "\n";
     }
     catch (const std::exception &e)
     {
@@ -94,6 +115,28 @@ void CliManager::connect_client(uint64_t client_id, const std::string &host, uin
     }
 }
 
+void CliManager::connect_client(uint64_t client_id, const LocalEndpoint &ep)
+{
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    auto it = clients_.find(client_id);
+    if (it == clients_.end())
+    {
+        std::cout << "Client " << client_id << " not found.\n";
+        return;
+    }
+
+    try
+    {
+        it->second.node->connect(ep);
+        std::cout << "Client " << client_id << " connecting to " << ep.uri() << "\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to connect client " << client_id << ": " << e.what() << "\n";
+    }
+}
+
 void CliManager::send_message(uint64_t from_id, uint64_t to_id, const std::string &message)
 {
     std::lock_guard<std::mutex> lock(clients_mutex_);
@@ -130,8 +173,12 @@ void CliManager::list_clients()
     std::cout << "Active clients:\n";
     for (const auto &[id, info] : clients_)
     {
-        std::cout << "  ID: " << id << ", Port: " << info.port
-                  << ", Status: " << (info.running ? "Running" : "Stopped") << "\n";
+        std::cout << "  ID: " << id << ", Port: " << info.port;
+        if (!info.node->local_path().empty())
+            std::cout << ", Local: " << info.node->local_path();
+        if (info.node->tuning().describe() != "default")
+            std::cout << ", Tuning: " << info.node->tuning().describe();
+        std::cout << ", Status: " << (info.running ? "Running" : "Stopped") << "\n";
     }
 }
 
@@ -146,13 +193,8 @@ void CliManager::stop_client(uint64_t id)
         return;
     }
 
-    if (it->second.thread && it->second.thread->joinable())
-    {
-        // Note: This is a graceful approach - in production you'd want proper shutdown signaling
-        it->second.running = false;
-        it->second.thread->join();
-    }
-
+    // Destroying the node stops its io thread, or detaches it from the pool
+    it->second.running = false;
     clients_.erase(it);
     std::cout << "Client " << id << " stopped.\n";
 }
@@ -162,28 +204,263 @@ void CliManager::stop_all()
     std::lock_guard<std::mutex> lock(clients_mutex_);
 
     for (auto &[id, info] : clients_)
+        info.running = false;
+
+    clients_.clear();
+    running_ = false;
+    std::cout << "All clients stopped.\n";
+}
+
+void CliManager::set_pool(std::size_t threads, const SocketTuning &placement)
+{
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    if (!clients_.empty())
     {
-        if (info.thread && info.thread->joinable())
+        std::cout << "Stop all clients before changing the executor mode.\n";
+        return;
+    }
+
+    if (threads == 0)
+    {
+        pool_.reset();
+        std::cout << "New clients will run on their own io thread.\n";
+        return;
+    }
+
+    pool_ = std::make_unique<IoPool>(threads, placement);
+    std::cout << "New clients will share a pool of " << pool_->size() << " io threads";
+    if (placement.places_threads())
+        std::cout << " (" << placement.describe() << ")";
+    std::cout << ".\n";
+}
+
+void CliManager::set_routing(uint64_t id, RoutingMode mode)
+{
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    auto it = clients_.find(id);
+    if (it == clients_.end())
+    {
+        std::cout << "Client " << id << " not found.\n";
+        return;
+    }
+
+    it->second.node->set_routing_mode(mode);
+    std::cout << "Client " << id << " routing: "
+              << (mode == RoutingMode::Learned ? "learned" : "flood") << "\n";
+}
+
+void CliManager::set_coalesce(uint64_t id, std::chrono::microseconds window)
+{
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    auto it = clients_.find(id);
+    if (it == clients_.end())
+    {
+        std::cout << "Client " << id << " not found.\n";
+        return;
+    }
+
+    it->second.options.coalesce_window = window;
+    it->second.node->set_connection_options(it->second.options);
+    std::cout << "Client " << id << " coalesce window: " << window.count()
+              << "us (new connections)\n";
+}
+
+void CliManager::set_queue_limits(uint64_t id, std::size_t max_bytes, std::size_t max_frames, OverflowPolicy policy)
+{
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    auto it = clients_.find(id);
+    if (it == clients_.end())
+    {
+        std::cout << "Client " << id << " not found.\n";
+        return;
+    }
+
+    auto &options = it->second.options;
+    options.max_queue_bytes = max_bytes;
+    options.max_queue_frames = max_frames;
+    options.overflow_policy = policy;
+    it->second.node->set_connection_options(options);
+    std::cout << "Client " << id << " write queue limit: " << max_bytes << " bytes, "
+              << max_frames << " frames (new connections)\n";
+}
+
+void CliManager::set_heartbeat(uint64_t id, std::chrono::milliseconds interval, std::chrono::milliseconds timeout)
+{
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    auto it = clients_.find(id);
+    if (it == clients_.end())
+    {
+        std::cout << "Client " << id << " not found.\n";
+        return;
+    }
+
+    auto &options = it->second.options;
+    options.heartbeat_interval = interval;
+    options.idle_timeout = timeout;
+    it->second.node->set_connection_options(options);
+    std::cout << "Client " << id << " heartbeat every " << interval.count() << "ms, idle timeout "
+              << timeout.count() << "ms (new connections)\n";
+}
+
+void CliManager::set_reconnect(uint64_t id, const ReconnectPolicy &policy)
+{
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    auto it = clients_.find(id);
+    if (it == clients_.end())
+    {
+        std::cout << "Client " << id << " not found.\n";
+        return;
+    }
+
+    it->second.node->set_reconnect_policy(policy);
+    if (policy.enabled)
+        std::cout << "Client " << id << " reconnects with backoff " << policy.initial_delay.count()
+                  << "ms up to " << policy.max_delay.count() << "ms\n";
+    else
+        std::cout << "Client " << id << " reconnect off\n";
+}
+
+void CliManager::show_stats(std::optional<uint64_t> id)
+{
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+
+    std::vector<uint64_t> ids;
+    for (const auto &[client_id, info] : clients_)
+    {
+        if (!id || client_id == *id)
+            ids.push_back(client_id);
+    }
+    if (ids.empty())
+    {
+        std::cout << (id ? "Client " + std::to_string(*id) + " not found.\n" : "No clients running.\n");
+        return;
+    }
+    std::sort(ids.begin(), ids.end());
+
+    for (uint64_t client_id : ids)
+    {
+        NodeStats s = clients_[client_id].node->stats();
+        const auto &r = s.routing;
+        std::cout << "Client " << s.id << ": recv=" << r.received << " dup=" << r.duplicates
+                  << " delivered=" << r.delivered << " forwarded=" << r.forwarded
+                  << " originated=" << r.originated << " ttl_expired=" << r.ttl_expired
+                  << " dropped=" << r.dropped << "\n"
+                  << "  bytes in=" << s.bytes_in << " out=" << s.bytes_out
+                  << ", queued " << s.queued_frames << " frames / " << s.queued_bytes << " bytes\n";
+
+        for (const auto &c : s.connections)
         {
-            info.running = false;
-            info.thread->join();
+            std::cout << "  " << c.remote
+                      << (c.node_id ? " node " + std::to_string(*c.node_id) : std::string(" (handshaking)"))
+                      << (c.open ? "" : " (closed)") << (c.standby ? " (standby)" : "")
+                      << ": in " << c.frames_in << " frames / " << c.bytes_in << " bytes"
+                      << ", out " << c.frames_out << " frames / " << c.bytes_out << " bytes in "
+                      << c.writes << " writes, queue " << c.queued_frames << " frames / "
+                      << c.queued_bytes << " bytes, dropped " << c.dropped << "\n";
         }
     }
+}
 
-    clients_.clear();
-    running_ = false;
-    std::cout << "All clients stopped.\n";
+std::string CliManager::render_metrics()
+{
+    std::vector<NodeStats> stats;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (auto &[id, info] : clients_)
+            stats.push_back(info.node->stats());
+    }
+    std::sort(stats.begin(), stats.end(), [](const NodeStats &a, const NodeStats &b)
+              { return a.id < b.id; });
+
+    std::ostringstream out;
+    write_prometheus(out, stats);
+    return out.str();
+}
+
+void CliManager::serve_metrics(uint16_t port)
+{
+    try
+    {
+        metrics_.reset();
+        metrics_ = std::make_unique<MetricsServer>(port, [this]
+                                                   { return render_metrics(); });
+        std::cout << "Serving metrics on http://127.0.0.1:" << metrics_->port() << "/metrics\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to serve metrics on port " << port << ": " << e.what() << "\n";
+    }
+}
+
+void CliManager::stop_metrics()
+{
+    metrics_.reset();
+    std::cout << "Metrics endpoint stopped.\n";
+}
+
+void CliManager::dump_metrics(const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << path << "\n";
+        return;
+    }
+    out << render_metrics();
+    std::cout << "Metrics written to " << path << "\n";
+}
+
+void CliManager::dump_trace(const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << path << "\n";
+        return;
+    }
+    auto events = Tracer::instance().snapshot();
+    Tracer::write_chrome_json(out, events);
+    std::cout << events.size() << " trace events written to " << path
+              << " (open in chrome://tracing or ui.perfetto.dev)\n";
 }
 
 void CliManager::print_help()
 {
     std::cout << "\nAvailable commands:\n"
-              << "  add <id> <port>              - Add and start a new client\n"
+              << "  add <id> <port> [local://<path>] [<tuning>]\n"
+              << "                               - Add and start a new client, optionally also on a unix socket;\n"
+              << "                                 tuning: nagle,sndbuf=N,rcvbuf=N,busy_poll=USEC,reuseport,\n"
+              << "                                 cpu=N|A-B,numa=N\n"
               << "  connect <client_id> <host> <port> - Connect client to another node\n"
+              << "  connect <client_id> <local://<path>|shm://<path>>\n"
+              << "                               - Same-host link over a unix socket or shared memory\n"
               << "  send <from_id> <to_id> <message>  - Send message from one client to another\n"
               << "  list                         - List all active clients\n"
               << "  stop <id>                    - Stop a specific client\n"
               << "  stopall                      - Stop all clients\n"
+              << "  pool <threads|auto|off> [<placement>]\n"
+              << "                               - Run new clients on a shared io thread pool,\n"
+              << "                                 placed by cpu=N|A-B,numa=N\n"
+              << "  route <id> <flood|learned>   - Select the routing mode of a client\n"
+              << "  coalesce <id> <usec>         - Write coalescing window for new connections\n"
+              << "  queue <id> <bytes> <frames> <block|drop-oldest|drop-newest|disconnect>\n"
+              << "                               - Write queue limits for new connections\n"
+              << "  heartbeat <id> <interval_ms> <timeout_ms>\n"
+              << "                               - Keepalive and idle timeout for new connections (0 = off)\n"
+              << "  reconnect <id> <on|off> [initial_ms] [max_ms]\n"
+              << "                               - Redial lost outbound connections with backoff\n"
+              << "  stats [id]                   - Message, byte and queue counters per client\n"
+              << "  metrics <serve <port>|dump <file>|off>\n"
+              << "                               - Prometheus text on 127.0.0.1:<port>, or to a file\n"
+              << "  log <trace|debug|info|warn|error|off> - Log level (stderr)\n"
+              << "  trace <one_in_n|off|dump <file>>\n"
+              << "                               - Sample messages for tracing; dump as Chrome trace JSON\n"
               << "  help                         - Show this help message\n"
               << "  quit / exit                  - Exit the CLI manager\n\n";
 }
@@ -200,21 +477,48 @@ void CliManager::process_command(const std::string &command)
     {
         uint64_t id;
         uint16_t port;
+        std::string arg;
         if (!(iss >> id >> port))
         {
-            std::cout << "Usage: add <id> <port>\n";
+            std::cout << "Usage: add <id> <port> [local://<path>] [<tuning>]\n";
             return;
         }
-        add_client(id, port);
+        std::optional<LocalEndpoint> local;
+        SocketTuning tuning;
+        while (iss >> arg)
+        {
+            if (auto ep = LocalEndpoint::parse(arg))
+            {
+                if (ep->link != LocalLink::Stream)
+                {
+                    std::cout << "Usage: add <id> <port> [local://<path>] [<tuning>]\n";
+                    return;
+                }
+                local = ep;
+            }
+            else
+                tuning = SocketTuning::parse(arg); // throws on a bad spec
+        }
+        add_client(id, port, local ? local->path : "", tuning);
     }
     else if (cmd == "connect")
     {
         uint64_t client_id;
         std::string host;
         uint16_t port;
-        if (!(iss >> client_id >> host >> port))
+        if (!(iss >> client_id >> host))
+        {
+            std::cout << "Usage: connect <client_id> <host> <port> | connect <client_id> <local|shm>://<path>\n";
+            return;
+        }
+        if (auto local = LocalEndpoint::parse(host))
+        {
+            connect_client(client_id, *local);
+            return;
+        }
+        if (!(iss >> port))
         {
-            std::cout << "Usage: connect <client_id> <host> <port>\n";
+            std::cout << "Usage: connect <client_id> <host> <port> | connect <client_id> <local|shm>://<path>\n";
             return;
         }
         connect_client(client_id, host, port);
@@ -256,6 +560,186 @@ void CliManager::process_command(const std::string &command)
     {
         stop_all();
     }
+    else if (cmd == "pool")
+    {
+        std::string arg, spec;
+        if (!(iss >> arg))
+        {
+            std::cout << "Usage: pool <threads|auto|off> [cpu=N|A-B,numa=N]\n";
+            return;
+        }
+        iss >> spec;
+        SocketTuning placement = SocketTuning::parse(spec); // throws on a bad spec
+        if (placement.no_delay || placement.send_buffer || placement.receive_buffer || placement.busy_poll_us ||
+            placement.reuse_port)
+        {
+            std::cout << "Socket options belong to 'add'; 'pool' only takes cpu= and numa=.\n";
+            return;
+        }
+        if (arg == "off")
+            set_pool(0);
+        else if (arg == "auto")
+            set_pool(std::max(1u, std::thread::hardware_concurrency()), placement);
+        else
+            set_pool(std::stoul(arg), placement);
+    }
+    else if (cmd == "route")
+    {
+        uint64_t id;
+        std::string mode;
+        if (!(iss >> id >> mode) || (mode != "flood" && mode != "learned"))
+        {
+            std::cout << "Usage: route <id> <flood|learned>\n";
+            return;
+        }
+        set_routing(id, mode == "learned" ? RoutingMode::Learned : RoutingMode::Flood);
+    }
+    else if (cmd == "coalesce")
+    {
+        uint64_t id;
+        uint64_t usec;
+        if (!(iss >> id >> usec))
+        {
+            std::cout << "Usage: coalesce <id> <usec>\n";
+            return;
+        }
+        set_coalesce(id, std::chrono::microseconds(usec));
+    }
+    else if (cmd == "queue")
+    {
+        uint64_t id;
+        std::size_t max_bytes, max_frames;
+        std::string policy;
+        if (!(iss >> id >> max_bytes >> max_frames >> policy))
+        {
+            std::cout << "Usage: queue <id> <bytes> <frames> <block|drop-oldest|drop-newest|disconnect>\n";
+            return;
+        }
+
+        static const std::unordered_map<std::string, OverflowPolicy> policies = {
+            {"block", OverflowPolicy::Block},
+            {"drop-oldest", OverflowPolicy::DropOldest},
+            {"drop-newest", OverflowPolicy::DropNewest},
+            {"disconnect", OverflowPolicy::Disconnect}};
+
+        auto p = policies.find(policy);
+        if (p == policies.end())
+        {
+            std::cout << "Unknown overflow policy: " << policy << "\n";
+            return;
+        }
+        set_queue_limits(id, max_bytes, max_frames, p->second);
+    }
+    else if (cmd == "heartbeat")
+    {
+        uint64_t id;
+        uint64_t interval_ms, timeout_ms;
+        if (!(iss >> id >> interval_ms >> timeout_ms))
+        {
+            std::cout << "Usage: heartbeat <id> <interval_ms> <timeout_ms>\n";
+            return;
+        }
+        set_heartbeat(id, std::chrono::milliseconds(interval_ms), std::chrono::milliseconds(timeout_ms));
+    }
+    else if (cmd == "reconnect")
+    {
+        uint64_t id;
+        std::string mode;
+        if (!(iss >> id >> mode) || (mode != "on" && mode != "off"))
+        {
+            std::cout << "Usage: reconnect <id> <on|off> [initial_ms] [max_ms]\n";
+            return;
+        }
+
+        ReconnectPolicy policy;
+        policy.enabled = mode == "on";
+        uint64_t ms;
+        if (iss >> ms)
+            policy.initial_delay = std::chrono::milliseconds(ms);
+        if (iss >> ms)
+            policy.max_delay = std::chrono::milliseconds(ms);
+        set_reconnect(id, policy);
+    }
+    else if (cmd == "stats")
+    {
+        uint64_t id;
+        if (iss >> id)
+            show_stats(id);
+        else
+            show_stats();
+    }
+    else if (cmd == "metrics")
+    {
+        std::string action;
+        iss >> action;
+        if (action == "serve")
+        {
+            uint16_t port;
+            if (iss >> port)
+            {
+                serve_metrics(port);
+                return;
+            }
+        }
+        else if (action == "dump")
+        {
+            std::string path;
+            if (iss >> path)
+            {
+                dump_metrics(path);
+                return;
+            }
+        }
+        else if (action == "off")
+        {
+            stop_metrics();
+            return;
+        }
+        std::cout << "Usage: metrics <serve <port>|dump <file>|off>\n";
+    }
+    else if (cmd == "log")
+    {
+        std::string name;
+        LogLevel level;
+        if (!(iss >> name) || !Logger::parse_level(name, level))
+        {
+            std::cout << "Usage: log <trace|debug|info|warn|error|off>\n";
+            return;
+        }
+        Logger::instance().set_level(level);
+        if (level < kLogMinLevel)
+            std::cout << "Note: this build compiles out lower levels (see RELAY_LOG_LEVEL)\n";
+        std::cout << "Log level: " << name << "\n";
+    }
+    else if (cmd == "trace")
+    {
+        std::string arg;
+        iss >> arg;
+        if (arg == "off")
+        {
+            Tracer::instance().set_sample_rate(0);
+            std::cout << "Tracing off.\n";
+        }
+        else if (arg == "dump")
+        {
+            std::string path;
+            if (!(iss >> path))
+            {
+                std::cout << "Usage: trace dump <file>\n";
+                return;
+            }
+            dump_trace(path);
+        }
+        else if (!arg.empty() && std::all_of(arg.begin(), arg.end(), ::isdigit))
+        {
+            Tracer::instance().set_sample_rate(std::stoul(arg));
+            std::cout << "Tracing one in " << arg << " messages.\n";
+        }
+        else
+        {
+            std::cout << "Usage: trace <one_in_n|off|dump <file>>\n";
+        }
+    }
     else if (cmd == "help")
     {
         print_help();
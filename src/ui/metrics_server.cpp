@@ -0,0 +1,58 @@
+#include "ui/metrics_server.hpp"
+
+MetricsServer::MetricsServer(uint16_t port, Render render)
+    : acceptor_(io_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)),
+      port_(acceptor_.local_endpoint().port()),
+      render_(std::move(render))
+{
+    accept_loop();
+    thread_ = std::thread([this]
+                          { io_.run(); });
+}
+
+MetricsServer::~MetricsServer()
+{
+    io_.stop();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void MetricsServer::accept_loop()
+{
+    acceptor_.async_accept([this](boost::system::error_code ec, tcp::socket socket)
+                           {
+        if (ec == boost::asio::error::operation_aborted)
+            return;
+        if (!ec)
+            serve(std::make_shared<tcp::socket>(std::move(socket)));
+        accept_loop(); });
+}
+
+void MetricsServer::serve(std::shared_ptr<tcp::socket> socket)
+{
+    auto request = std::make_shared<std::string>();
+    boost::asio::async_read_until(
+        *socket, boost::asio::dynamic_buffer(*request, 8192), "\r\n\r\n",
+        [this, socket, request](boost::system::error_code ec, std::size_t)
+        {
+            if (ec)
+                return;
+
+            std::string body = render_();
+            auto response = std::make_shared<std::string>(
+                "HTTP/1.1 200 OK\r\n"
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: " +
+                std::to_string(body.size()) +
+                "\r\n"
+                "Connection: close\r\n\r\n" +
+                body);
+
+            boost::asio::async_write(*socket, boost::asio::buffer(*response),
+                                     [socket, response](boost::system::error_code, std::size_t)
+                                     {
+                                         boost::system::error_code ignored;
+                                         socket->shutdown(tcp::socket::shutdown_both, ignored);
+                                     });
+        });
+}